@@ -0,0 +1,377 @@
+#include "gc-arena.c"
+#include "../vendor/utest.h"
+
+// This is a reproduction of the mruby default allocf function.
+void *bench_allocf(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  } else {
+    return realloc(ptr, size);
+  }
+}
+static mrb_allocf fallback_allocf = bench_allocf;
+
+// Results are printed one JSON object per line, for easy comparison between
+// runs; `bytes_wasted` is null where the allocator doesn't expose it.
+static void report(const char *name, const char *allocator, size_t ops, utest_int64_t ns, long long wasted) {
+  printf("{\"name\": \"%s\", \"allocator\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.2f, \"bytes_wasted\": ", name, allocator, ops, (double)ns / ops);
+  if (wasted < 0) {
+    printf("null}\n");
+  } else {
+    printf("%lld}\n", wasted);
+  }
+}
+
+// Bytes held by the Arena beyond those requested, including size tags,
+// padding, abandoned blocks and unusable page tails.
+static long long arena_waste(struct gc_arena *arena, size_t requested) {
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  return stats.total_storage - requested;
+}
+
+static void *ptrs[1 << 20];
+
+// Many small allocations, in the size range of typical strings and arrays.
+static void bench_small_allocations(void) {
+  enum { OPS = 1 << 20 };
+  size_t requested = 0;
+  for (size_t idx = 0; idx < OPS; idx++) requested += 8 + (idx * 7) % 57;
+
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, requested);
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, 8 + (idx * 7) % 57, arena);
+  ns = utest_ns() - ns;
+  report("small_allocations", "arena", OPS, ns, arena_waste(arena, requested));
+  gc_arena_free(NULL, arena);
+
+  ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, 8 + (idx * 7) % 57, NULL);
+  ns = utest_ns() - ns;
+  report("small_allocations", "fallback", OPS, ns, -1);
+  for (size_t idx = 0; idx < OPS; idx++) gc_arena_allocf(NULL, ptrs[idx], 0, NULL);
+}
+
+// Small allocations through the allocator, next to the bump allocation alone
+// (the whole of the allocator's malloc path before Arenas could recycle
+// storage or carve heap pages).
+static void bench_bump_malloc(void) {
+  enum { OPS = 1 << 20 };
+  const char *modes[] = {"arena", "baseline"};
+
+  for (int mode = 0; mode < 2; mode++) {
+    struct gc_arena *arena = gc_arena_allocate(NULL, 0, (size_t)OPS * 32);
+    memset(arena->page->ptr, 0, arena->page->end - arena->page->ptr);
+
+    utest_int64_t ns = utest_ns();
+    if (mode) {
+      for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = alloc_with_arena(arena, 24);
+    } else {
+      for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, 24, arena);
+    }
+    ns = utest_ns() - ns;
+    report("bump_malloc", modes[mode], OPS, ns, -1);
+    gc_arena_free(NULL, arena);
+  }
+}
+
+// Frees, as issued by mruby when objects are released or resized.
+static void bench_free(void) {
+  enum { OPS = 1 << 20 };
+  const char *modes[] = {"arena", "arena_recycle"};
+
+  for (int mode = 0; mode < 2; mode++) {
+    struct gc_arena *arena = gc_arena_allocate(NULL, 0, (size_t)OPS * 40);
+    gc_arena_set_recycle(arena, mode);
+    for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, 32, arena);
+
+    utest_int64_t ns = utest_ns();
+    for (size_t idx = 0; idx < OPS; idx++) gc_arena_allocf(NULL, ptrs[idx], 0, arena);
+    ns = utest_ns() - ns;
+    report("free", modes[mode], OPS, ns, -1);
+    gc_arena_free(NULL, arena);
+  }
+
+  for (size_t idx = 0; idx < OPS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, 32, NULL);
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) gc_arena_allocf(NULL, ptrs[idx], 0, NULL);
+  ns = utest_ns() - ns;
+  report("free", "fallback", OPS, ns, -1);
+}
+
+// Strings grown by repeated appends, interleaved so that only some of them
+// are the most recent allocation on their page.
+static void bench_string_growth(void) {
+  enum { STRINGS = 256, STEPS = 64 };
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024 * 1024);
+  size_t sizes[STRINGS] = {0};
+  size_t requested = 0;
+
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < STRINGS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, sizes[idx] = 16, arena);
+  for (size_t step = 0; step < STEPS; step++) {
+    for (size_t idx = 0; idx < STRINGS; idx += 1 + step % 3) {
+      sizes[idx] += sizes[idx] / 2 > 256 ? 256 : sizes[idx] / 2;
+      ptrs[idx] = gc_arena_allocf(NULL, ptrs[idx], sizes[idx], arena);
+    }
+  }
+  ns = utest_ns() - ns;
+  for (size_t idx = 0; idx < STRINGS; idx++) requested += sizes[idx];
+  report("string_growth", "arena", STRINGS * STEPS, ns, arena_waste(arena, requested));
+  gc_arena_free(NULL, arena);
+
+  memset(sizes, 0, sizeof(sizes));
+  ns = utest_ns();
+  for (size_t idx = 0; idx < STRINGS; idx++) ptrs[idx] = gc_arena_allocf(NULL, NULL, sizes[idx] = 16, NULL);
+  for (size_t step = 0; step < STEPS; step++) {
+    for (size_t idx = 0; idx < STRINGS; idx += 1 + step % 3) {
+      sizes[idx] += sizes[idx] / 2 > 256 ? 256 : sizes[idx] / 2;
+      ptrs[idx] = gc_arena_allocf(NULL, ptrs[idx], sizes[idx], NULL);
+    }
+  }
+  ns = utest_ns() - ns;
+  report("string_growth", "fallback", STRINGS * STEPS, ns, -1);
+  for (size_t idx = 0; idx < STRINGS; idx++) gc_arena_allocf(NULL, ptrs[idx], 0, NULL);
+}
+
+// Reallocations of data owned by a different Arena than the active one.
+static void bench_cross_arena_realloc(void) {
+  enum { ARENAS = 16, PAGES = 64, OPS = 1 << 18 };
+  struct gc_arena *arenas[ARENAS];
+  for (int idx = 0; idx < ARENAS; idx++) {
+    arenas[idx] = gc_arena_allocate(NULL, 0, 0);
+    for (int page = 0; page < PAGES; page++) {
+      add_page(arenas[idx], 0);
+      ptrs[idx * PAGES + page] = alloc_with_arena(arenas[idx], 8);
+    }
+  }
+
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    void *ptr = ptrs[(idx * 7919) % (ARENAS * PAGES)];
+    gc_arena_allocf(NULL, ptr, 8, arenas[idx % ARENAS]);
+  }
+  ns = utest_ns() - ns;
+  report("cross_arena_realloc", "arena", OPS, ns, -1);
+
+  for (int idx = 0; idx < ARENAS; idx++) gc_arena_free(NULL, arenas[idx]);
+}
+
+// Reallocations of blocks spread over many Arenas and pages, found through the
+// address index, compared with walking every Arena's pages to find them.
+static void bench_realloc_lookup(void) {
+  enum { ARENAS = 12, PAGES = 256, OPS = 1 << 16 };
+  struct gc_arena *arenas[ARENAS];
+  for (int idx = 0; idx < ARENAS; idx++) {
+    arenas[idx] = gc_arena_allocate(NULL, 0, 0);
+    for (int page = 0; page < PAGES; page++) {
+      add_page(arenas[idx], 0);
+      ptrs[idx * PAGES + page] = alloc_with_arena(arenas[idx], 8);
+    }
+  }
+
+  // Touch the oldest pages first, since they are the worst case for a walk.
+  size_t found = 0;
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    void *ptr = ptrs[idx % (ARENAS * PAGES)];
+    for (int arena = 0; arena < ARENAS; arena++) {
+      struct gc_arena_page *page = arenas[arena]->page;
+      while (page && (ptr < page->start || ptr >= page->end)) page = page->next;
+      if (page) {
+        found++;
+        break;
+      }
+    }
+  }
+  ns = utest_ns() - ns;
+  if (found != OPS) fprintf(stderr, "realloc_lookup: %zu of %d blocks found\n", found, OPS);
+  report("realloc_lookup", "linear_page_walk", OPS, ns, -1);
+
+  ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) gc_arena_allocf(NULL, ptrs[idx % (ARENAS * PAGES)], 8, NULL);
+  ns = utest_ns() - ns;
+  report("realloc_lookup", "arena", OPS, ns, -1);
+
+  for (int idx = 0; idx < ARENAS; idx++) gc_arena_free(NULL, arenas[idx]);
+}
+
+// Resets of a large Arena after light use, as with a per-frame scratch Arena.
+static void bench_reset(void) {
+  enum { OBJECTS = 1 << 20, OPS = 1 << 12 };
+  struct gc_arena *arena = gc_arena_allocate(NULL, OBJECTS, 1024 * 1024);
+
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    for (int obj = 0; obj < 16; obj++) gc_arena_allocf(NULL, NULL, 48, arena);
+    gc_arena_reset(NULL, arena);
+  }
+  ns = utest_ns() - ns;
+  report("reset_large_arena", "arena", OPS, ns, -1);
+  gc_arena_free(NULL, arena);
+}
+
+static void bench_initialize_heap(void) {
+  enum { OPS = 1 << 12 };
+  mrb_heap_page *heap = malloc(GC_ARENA_HEAP_BYTES);
+
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) heap->freelist = gc_arena_initialize_heap(heap, GC_ARENA_HEAP_SLOTS);
+  ns = utest_ns() - ns;
+  report("initialize_heap", "arena", OPS, ns, -1);
+  free(heap);
+}
+
+static void bench_stats(void) {
+  enum { OPS = 1 << 16 };
+  struct gc_arena *arena = gc_arena_allocate(NULL, 4096, 0);
+  for (size_t idx = 0; idx < 256; idx++) alloc_with_arena(arena, 1024);
+
+  struct gc_arena_stats stats;
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) gc_arena_stats(NULL, arena, &stats);
+  ns = utest_ns() - ns;
+  report("stats", "arena", OPS, ns, -1);
+  gc_arena_free(NULL, arena);
+}
+
+// Allocations well beyond the preallocated storage, under each growth policy.
+static void bench_overflow(void) {
+  enum { OPS = 1 << 18 };
+  const char *modes[] = {"arena_fixed", "arena_geometric"};
+
+  for (int mode = 0; mode < 2; mode++) {
+    struct gc_arena *arena = gc_arena_allocate(NULL, 0, 0);
+    arena->growth.mode = mode ? GC_ARENA_GROWTH_GEOMETRIC : GC_ARENA_GROWTH_FIXED;
+    size_t requested = 0;
+
+    utest_int64_t ns = utest_ns();
+    for (size_t idx = 0; idx < OPS; idx++) {
+      size_t size = 16 + (idx * 31) % 1009;
+      gc_arena_allocf(NULL, NULL, size, arena);
+      requested += size;
+    }
+    ns = utest_ns() - ns;
+    report("multi_page_overflow", modes[mode], OPS, ns, arena_waste(arena, requested));
+    gc_arena_free(NULL, arena);
+  }
+}
+
+// The only API calls made by `GC::Arena#enter` and `#leave`.
+static void *bench_get_datatype(mrb_state *mrb, mrb_value self, const mrb_data_type *type) {
+  return ((struct RData *)mrb_ptr(self))->data;
+}
+
+static void bench_ary_set(mrb_state *mrb, mrb_value ary, mrb_int idx, mrb_value value) {
+  RARRAY_PTR(ary)[idx] = value;
+}
+
+static struct drb_api_t bench_api = {
+  .mrb_get_datatype = bench_get_datatype,
+  .mrb_ary_set = bench_ary_set,
+};
+
+static mrb_value bench_empty_m(mrb_state *mrb, mrb_value self) {
+  return mrb_nil_value();
+}
+
+// Switches in and out of an Arena, as by `GC::Arena#enter` and `#leave`, from
+// the GC heap and from within another Arena, keeping the Arena's owner alive
+// in a root slot. The methods themselves are compared with an empty method,
+// each called through a pointer as mruby would.
+static void bench_switch(void) {
+  enum { OPS = 1 << 20 };
+  api = &bench_api;
+  mrb_value slots[GC_ARENA_MAX_ENTERED];
+  struct RArray roots = {.tt = MRB_TT_ARRAY, .as.heap = {.len = GC_ARENA_MAX_ENTERED, .aux.capa = GC_ARENA_MAX_ENTERED, .ptr = slots}};
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = bench_allocf, .roots = mrb_obj_value(&roots)};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *outer = gc_arena_allocate(&mrb, 1024, 0);
+  struct gc_arena *inner = gc_arena_allocate(&mrb, 1024, 0);
+  struct RData owner = {.tt = MRB_TT_DATA, .type = &gc_arena_data_type, .data = inner};
+  mrb_value self = mrb_obj_value(&owner);
+
+  utest_int64_t ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    gc_arena_enter(&mrb, inner, self);
+    gc_arena_leave(&mrb, inner);
+  }
+  ns = utest_ns() - ns;
+  report("switch_from_gc_heap", "arena", OPS, ns, -1);
+
+  gc_arena_enter(&mrb, outer, mrb_nil_value());
+  ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    gc_arena_enter(&mrb, inner, self);
+    gc_arena_leave(&mrb, inner);
+  }
+  ns = utest_ns() - ns;
+  report("switch_between_arenas", "arena", OPS, ns, -1);
+  gc_arena_leave(&mrb, outer);
+
+  mrb_func_t volatile methods[3] = {gc_arena_enter_m, gc_arena_leave_m, bench_empty_m};
+  ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    methods[0](&mrb, self);
+    methods[1](&mrb, self);
+  }
+  ns = utest_ns() - ns;
+  report("enter_leave_methods", "arena", OPS, ns, -1);
+
+  ns = utest_ns();
+  for (size_t idx = 0; idx < OPS; idx++) {
+    methods[2](&mrb, self);
+    methods[2](&mrb, self);
+  }
+  ns = utest_ns() - ns;
+  report("enter_leave_methods", "empty_method", OPS, ns, -1);
+
+  gc_arena_free(&mrb, outer);
+  gc_arena_free(&mrb, inner);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+// An Array of 1000 elements, each with storage of its own, built by doubling
+// its capacity as mruby does, and built at its final capacity up front (as by
+// `GC::Arena#array`).
+static void bench_collection_capacity(void) {
+  enum { ARRAYS = 64, ELEMENTS = 1000, ELEMENT_SIZE = 32 };
+  const char *modes[] = {"arena_growth", "arena_exact"};
+
+  for (int mode = 0; mode < 2; mode++) {
+    struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024 * 1024);
+    size_t requested = 0;
+
+    utest_int64_t ns = utest_ns();
+    for (size_t idx = 0; idx < ARRAYS; idx++) {
+      size_t capa = mode ? ELEMENTS : 4;
+      void *array = gc_arena_allocf(NULL, NULL, capa * sizeof(mrb_value), arena);
+      for (size_t len = 0; len < ELEMENTS; len++) {
+        if (len == capa) array = gc_arena_allocf(NULL, array, (capa *= 2) * sizeof(mrb_value), arena);
+        gc_arena_allocf(NULL, NULL, ELEMENT_SIZE, arena);
+      }
+      requested += capa * sizeof(mrb_value) + ELEMENTS * ELEMENT_SIZE;
+    }
+    ns = utest_ns() - ns;
+    report("collection_capacity", modes[mode], ARRAYS * ELEMENTS, ns, arena_waste(arena, requested));
+    gc_arena_free(NULL, arena);
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  bench_small_allocations();
+  bench_bump_malloc();
+  bench_free();
+  bench_string_growth();
+  bench_cross_arena_realloc();
+  bench_realloc_lookup();
+  bench_reset();
+  bench_initialize_heap();
+  bench_stats();
+  bench_overflow();
+  bench_switch();
+  bench_collection_capacity();
+  return 0;
+}
@@ -1,10 +1,85 @@
 #include "dragonruby.h"
 
-#define MAX_ARENAS 64
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Arena descriptors are handed out from blocks that double in size (64, 128,
+// 256, ...) and are never moved, so pointers to them remain stable.
+#define GC_ARENA_BLOCK_SIZE 64
+#define GC_ARENA_MAX_BLOCKS 32
+
+// The deepest nesting of `GC::Arena#enter` calls.
+#define GC_ARENA_MAX_ENTERED 32
+
+// Default sizing for overflow pages; enough to house a full mruby heap page.
+#define GC_ARENA_PAGE_SIZE (sizeof(ObjectSlot) * 1024)
+#define GC_ARENA_MAX_PAGE_SIZE (64 * 1024 * 1024)
+
+// Size classes for recycled storage: 8 byte steps up to 256 bytes, then four
+// steps per power of two up to 1MB. Larger blocks are never recycled.
+#define GC_ARENA_SMALL_CLASSES 32
+#define GC_ARENA_SIZE_CLASSES (GC_ARENA_SMALL_CLASSES + 4 * 12)
+#define GC_ARENA_MAX_RECYCLED (1 << 20)
+
+// Allocations beyond an Arena's limits are carved from fallback pages of at
+// least this size.
+#define GC_ARENA_FALLBACK_PAGE_SIZE (16 * 1024)
+
+// Blocks in the small size classes are carved from runs of this many bytes,
+// each holding a single class, so that those blocks need no size tag.
+#define GC_ARENA_RUN_BYTES 4096
+
+// Object slots beyond the first heap page are handed out lazily, one mruby
+// heap page (of MRB_HEAP_PAGE_SIZE slots) at a time. Each is preceded by a size
+// tag, just like any other allocation.
+#define GC_ARENA_HEAP_SLOTS 1024
+#define GC_ARENA_HEAP_BYTES (sizeof(mrb_heap_page) + sizeof(ObjectSlot) * GC_ARENA_HEAP_SLOTS)
+#define GC_ARENA_CHUNK_BYTES (8 + GC_ARENA_HEAP_BYTES)
+
+// Default sizing for object pages, which hold only heap pages (in whole
+// chunks) once the preallocated object slots run out.
+#define GC_ARENA_OBJECT_PAGE_SIZE (GC_ARENA_CHUNK_BYTES * 8)
+
+// The initial number of entries in an Arena's string interning table.
+#define GC_ARENA_INTERN_CAPA 64
+
+// Granularity for committing reserved address space; this is also the size of
+// a transparent huge page on x86-64.
+#define GC_ARENA_VM_CHUNK (2 * 1024 * 1024)
 
 // Skipped during GC traversal.
 #define GC_RED 7
 
+// Allocation traces begin with a magic number and version, followed by fixed
+// size little-endian records: op (u8), arena (u32), id (u32) and size (u64).
+#define GC_ARENA_TRACE_MAGIC "GCAT"
+#define GC_ARENA_TRACE_VERSION 1
+#define GC_ARENA_TRACE_RECORD_SIZE 17
+
+// Arena images hold a header, the page table, the class and symbol tables and
+// their names, then the pages themselves (page aligned within the file), and
+// finally a bitmap marking each word of page data that points into the Arena.
+#define GC_ARENA_IMAGE_MAGIC "GCAI"
+#define GC_ARENA_IMAGE_VERSION 5
+#define GC_ARENA_IMAGE_ALIGN 4096
+
+// Set on images whose values must be revisited on load even if no symbols have
+// changed, such as those referencing classes or hashes keyed by object.
+#define GC_ARENA_IMAGE_FIXUP_VALUES 1
+
+// Allocation profiles are only collected in builds with GC_ARENA_PROFILE.
+#ifdef GC_ARENA_PROFILE
+#define PROFILE(...) __VA_ARGS__
+#else
+#define PROFILE(...)
+#endif
+
 #ifndef MRB
 #define MRB(method) api->method
 #endif
@@ -24,18 +99,243 @@ struct gc_arena_page {
   void *last;
   void *ptr;
   void *end;
+
+  // Pages backed by reserved address space commit memory on demand, up to
+  // `limit`; memory above `floor` is discarded on reset.
+  void *floor;
+  void *limit;
+
+  // Shared pages are carved from a larger allocation owned elsewhere (e.g. by
+  // a Ring), and are not freed along with the Arena.
+  mrb_bool shared;
+
+  // Fallback pages hold a single allocation beyond the Arena's limits, and are
+  // not counted as part of its storage.
+  mrb_bool fallback;
+
+  // Run pages hold untagged blocks of a single size, recorded here instead.
+  size_t run_size;
+};
+
+enum gc_arena_growth_mode {
+  GC_ARENA_GROWTH_FIXED,
+  GC_ARENA_GROWTH_GEOMETRIC,
+};
+
+// Determines the size of each overflow page.
+//   * Fixed growth allocates `page_size` bytes beyond the triggering request.
+//   * Geometric growth starts at `page_size` bytes, multiplying the size of
+//     each subsequent page by `factor`, up to `max_page_size` bytes.
+struct gc_arena_growth {
+  enum gc_arena_growth_mode mode;
+  double factor;
+  size_t page_size;
+  size_t max_page_size;
+  size_t next_page_size;
+};
+
+// Determines what happens to allocations beyond an Arena's limits.
+//   * Raise fails the allocation, which mruby reports as a NoMemoryError.
+//   * Fallback serves the allocation from the fallback allocator instead.
+//   * Hook falls back, and reports the overflow to a Ruby callable once the
+//     eval that overflowed has returned.
+enum gc_arena_overflow_policy {
+  GC_ARENA_OVERFLOW_RAISE,
+  GC_ARENA_OVERFLOW_FALLBACK,
+  GC_ARENA_OVERFLOW_HOOK,
+};
+
+// An open-addressed table of the strings interned by an Arena, kept at most
+// half full. The table lives in the Arena's own storage, and is discarded
+// along with it on reset or rewind.
+struct gc_arena_intern_entry {
+  uint64_t hash;
+  struct RString *str;
+};
+
+struct gc_arena_intern {
+  size_t count;
+  size_t capa;
+  struct gc_arena_intern_entry entries[];
+};
+
+// Running totals for the active pages of an Arena, maintained as it allocates
+// so that stats can be read in constant time.
+struct gc_arena_counters {
+  size_t pages;
+  size_t objects;
+  size_t storage;
+  size_t used;
+  size_t overflow;
+
+  // Used storage spent on size tags, and on padding blocks out to their
+  // alignment (or size class).
+  size_t headers;
+  size_t padding;
+
+  // Storage wasted by blocks left behind when a reallocation moved them, by
+  // blocks passed to free (neither counting blocks reclaimed for recycling),
+  // and by page tails skipped in favor of a new page. Skipped tails are free
+  // rather than used storage.
+  size_t abandoned;
+  size_t freed;
+  size_t skipped;
+
+  // Object pages, and the bytes they hold.
+  size_t object_pages;
+  size_t object_storage;
+
+  // String contents which interning has not had to copy.
+  size_t deduplicated;
+
+  // Object slots in heap pages served by the fallback allocator.
+  size_t fallback_objects;
+};
+
+#ifdef GC_ARENA_PROFILE
+// Storage allocations are bucketed by the log2 of their size, rounded up.
+struct gc_arena_profile {
+  size_t sizes[64];
+  size_t realloc_in_place;
+  size_t realloc_copied;
 };
+#endif
 
 struct gc_arena {
+  struct gc_arena_registry *registry;
   mrb_gc gc;
   size_t initial_objects;
-  void *beg;
+  mrb_heap_page *heap;
+  mrb_heap_page *heaps_tail;
+  void *frontier;
+  void *frontier_end;
+  struct gc_arena_page *page;
+  struct gc_arena_growth growth;
+
+  // Heap pages beyond the preallocated slots are carved from object pages, kept
+  // apart from storage so that object slots remain densely packed.
+  struct gc_arena_page *object_page;
+  struct gc_arena_growth object_growth;
+  struct gc_arena_intern *intern;
+  struct gc_arena_savepoint *savepoints;
+  struct gc_arena_page *spare;
+  struct gc_arena_page *object_spare;
+  size_t spare_bytes;
+  size_t retain_bytes;
+  size_t overflow_high_water;
+  size_t object_high_water;
+  mrb_bool coalesce;
+  mrb_bool recycle;
+
+  // Requests smaller than this go straight to the bump allocator; they can't
+  // be heap pages, and it is zero while recycling.
+  size_t bump_below;
+  void *free_blocks[GC_ARENA_SIZE_CLASSES];
+
+  // Run pages, and the current run for each small size class. Run pages are
+  // all the same size, so those retained are kept apart and never coalesced.
+  struct gc_arena_page *run_page;
+  struct gc_arena_page *run_spare;
+  struct gc_arena_page *runs[GC_ARENA_SMALL_CLASSES];
+  struct gc_arena_counters counters;
+  size_t peak_live_objects;
+  size_t peak_used_storage;
+  size_t peak_pages;
+#ifdef GC_ARENA_TRACE
+  uint32_t trace_id;
+#endif
+#ifdef GC_ARENA_PROFILE
+  struct gc_arena_profile profile;
+#endif
+
+  // Optional limits on object slots and storage (zero when unlimited), and
+  // the pages taken from the fallback allocator for allocations beyond them.
+  size_t max_objects;
+  size_t max_storage;
+  enum gc_arena_overflow_policy on_overflow;
+  mrb_value overflow_hook;
+  mrb_bool overflowing;
+  size_t overflow_pending_objects;
+  size_t overflow_pending_storage;
+  size_t overflows;
+  struct gc_arena_page *fallback;
+  size_t fallback_storage;
+
+  // Arenas loaded from an image live within its mapping, which they own.
+  void *image;
+  size_t image_size;
+
+  struct gc_arena *next_free;
+};
+
+// An entry in the address index, mapping a page's address range back to the
+// Arena that owns it.
+struct gc_arena_range {
+  void *start;
   void *end;
+  struct gc_arena *arena;
   struct gc_arena_page *page;
 };
 
+// An active `eval`, switching the state into an Arena (or, with a NULL Arena,
+// back to the GC heap) until it returns. Evals form a stack for each state.
+struct gc_arena_eval_cb_data {
+  struct gc_arena *arena;
+  mrb_value block;
+  mrb_value (*func)(mrb_state *mrb, void *data);
+  void *func_data;
+  void *original_allocf_ud;
+  int original_arena_idx;
+  size_t original_entered;
+
+  // The object kept alive while an entered Arena remains active (or nil).
+  mrb_value owner;
+
+  // The context `GC::Arena.outer` switches to from within this eval, and the
+  // eval this one is nested in.
+  void *parent;
+  struct gc_arena_eval_cb_data *prev;
+};
+
+// The Arenas of a single mrb_state, with the allocator they fall back to.
+// States reach their registry through `allocf_ud`; since an Arena replaces it
+// during `eval`, Arenas and registries both begin with the registry pointer
+// (a registry pointing to itself).
+struct gc_arena_registry {
+  struct gc_arena_registry *registry;
+  mrb_allocf allocf;
+  void *allocf_ud;
+
+  // Arena descriptors, allocated in blocks of doubling size.
+  struct gc_arena *blocks[GC_ARENA_MAX_BLOCKS];
+  uint8_t block_count;
+  size_t block_used;
+  struct gc_arena *free_list;
+
+  // Page ranges for every live Arena, sorted by start address. Released pages
+  // leave empty ranges behind, which are dropped in bulk.
+  struct gc_arena_range *ranges;
+  size_t range_count;
+  size_t range_capa;
+  size_t range_tombstones;
+
+  // The state's own GC, parked while an Arena is active, and the innermost
+  // active eval. Evals begun by `GC::Arena#enter` outlive the call, and are
+  // kept here, their owners held by an Array of as many slots (allocated and
+  // registered as a GC root once, with the registry).
+  mrb_gc gc;
+  struct gc_arena_eval_cb_data *evals;
+  struct gc_arena_eval_cb_data entered[GC_ARENA_MAX_ENTERED];
+  size_t entered_count;
+  mrb_value roots;
+
+  // The names of the stats, interned when the extension is registered.
+  mrb_sym *stat_keys;
+};
+
 struct gc_arena_stats {
   size_t pages;
+  size_t average_page_size;
   size_t total_memory;
   size_t used_memory;
   size_t total_objects;
@@ -44,13 +344,251 @@ struct gc_arena_stats {
   size_t total_storage;
   size_t used_storage;
   size_t free_storage;
+  size_t retained_storage;
+  size_t reserved_storage;
+  size_t header_storage;
+  size_t padding_storage;
+  size_t abandoned_storage;
+  size_t freed_storage;
+  size_t skipped_storage;
+  size_t storage_efficiency;
+  size_t object_pages;
+  size_t object_storage;
+  size_t deduplicated_storage;
+  size_t max_objects;
+  size_t max_storage;
+  size_t overflows;
+  size_t fallback_objects;
+  size_t fallback_storage;
+  size_t peak_live_objects;
+  size_t peak_used_storage;
+  size_t peak_pages;
 };
 
-struct gc_arena_eval_cb_data {
-  mrb_value self;
+// A savepoint, capturing the allocation state of an Arena.
+struct gc_arena_mark {
+  struct gc_arena_page *page;
+  void *ptr;
+  void *last;
+  mrb_heap_page *heaps;
+  mrb_heap_page *heaps_tail;
+  mrb_heap_page *free_heaps;
+  mrb_heap_page *free_next;
+  void *freelist;
+  void *frontier;
+  struct gc_arena_page *object_page;
+  void *object_ptr;
+  struct gc_arena_page *run_page;
+  size_t live;
+  void *committed;
+  struct gc_arena_counters counters;
+};
+
+// A savepoint handed out by `GC::Arena#mark`. Savepoints live outside the
+// Arena, so that rewinding can't release them, and each Arena chains its valid
+// savepoints from newest to oldest; those invalidated by a reset (or by
+// rewinding to an earlier savepoint) are unlinked, and forget their Arena.
+struct gc_arena_savepoint {
+  struct gc_arena *arena;
+  struct gc_arena_savepoint *older;
+  struct gc_arena_savepoint *newer;
+  struct gc_arena_mark mark;
+};
+
+enum gc_arena_trace_op {
+  GC_ARENA_TRACE_NEW,     // id: object count, size: storage bytes
+  GC_ARENA_TRACE_DESTROY,
+  GC_ARENA_TRACE_MALLOC,  // id: block, size: requested bytes
+  GC_ARENA_TRACE_REALLOC, // id: block, size: requested bytes
+  GC_ARENA_TRACE_FREE,    // id: block
+  GC_ARENA_TRACE_RESET,
+  GC_ARENA_TRACE_MARK,    // id: savepoint
+  GC_ARENA_TRACE_REWIND,  // id: savepoint
+  GC_ARENA_TRACE_EVAL,
+  GC_ARENA_TRACE_LEAVE,
+};
+
+struct gc_arena_trace_record {
+  uint8_t op;
+  uint32_t arena;
+  uint32_t id;
+  uint64_t size;
+};
+
+struct gc_arena_ring {
+  void *memory;
+  size_t current;
+  size_t count;
+  struct gc_arena *generations[];
+};
+
+struct gc_arena_image_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t slot_size;
+  uint32_t value_size;
+  uint32_t flags;
+  uint32_t page_count;
+  uint64_t class_count;
+  uint64_t symbol_count;
+  uint64_t names_size;
+  uint64_t data_offset;
+  uint64_t data_size;
+
+  // Addresses within the original Arena, relocated on load.
+  uint64_t heaps;
+  uint64_t free_heaps;
+  uint64_t heap;
+  uint64_t frontier;
+  uint64_t frontier_end;
+  uint64_t root;
+
+  uint64_t live;
+  uint64_t initial_objects;
+  uint64_t objects;
+  uint64_t headers;
+  uint64_t padding;
+  uint64_t abandoned;
+  uint64_t freed;
+
+  // The number of pages (listed first) which hold heap pages.
+  uint64_t object_pages;
+};
+
+// A page of the original Arena, stored `offset` bytes into the page data. Pages
+// are listed newest first, as in the Arena's page list.
+struct gc_arena_image_page {
+  uint64_t address;
+  uint64_t size;
+  uint64_t offset;
+};
+
+// Classes are keyed by their original address, and symbols by their original
+// id; both are resolved by name on load.
+struct gc_arena_image_name {
+  uint64_t key;
+  uint64_t offset;
+  uint64_t len;
+};
+
+// Names collected while dumping an Arena, deduplicated by key.
+struct gc_arena_image_names {
+  struct gc_arena_image_name *entries;
+  size_t count;
+  size_t *slots;
+  size_t slot_capa;
+  char *buffer;
+  size_t size;
+  size_t buffer_capa;
+};
+
+// An image file mapped into memory.
+struct gc_arena_image {
+  void *map;
+  size_t size;
+  struct gc_arena_image_header *header;
+  struct gc_arena_image_page *pages;
+  struct gc_arena_image_name *classes;
+  struct gc_arena_image_name *symbols;
+  const char *names;
+  void *data;
+  uint64_t *bitmap;
+};
+
+// The original address range of a page, where its contents now live, and where
+// they are stored within the image's page data.
+struct gc_arena_image_span {
+  uint64_t address;
+  uint64_t size;
+  void *base;
+  uint64_t offset;
+};
+
+// State for flagging the words of an Arena being dumped which hold pointers
+// into its pages.
+struct gc_arena_image_scan {
+  struct gc_arena *arena;
+  struct gc_arena_image_span *spans;
+  size_t count;
+  uint64_t *bitmap;
+};
+
+// State for walking the objects of an Arena being dumped.
+struct gc_arena_dump {
+  struct gc_arena *arena;
+  struct gc_arena_image_names classes;
+  struct gc_arena_image_names symbols;
+  uint32_t flags;
+  const char *error;
+};
+
+// State for walking the objects of an Arena being loaded, with the image's
+// classes and symbols resolved in the current runtime.
+struct gc_arena_load {
+  struct gc_arena_image *image;
+  struct RClass **classes;
+  mrb_sym *symbols;
+  struct gc_arena_load_pair {
+    mrb_value key;
+    mrb_value value;
+  } *pairs;
+  size_t count;
+  size_t capa;
+};
+
+// State for deep-copying an object graph into the active Arena. Each copied
+// object is recorded in an open-addressed table, keyed by the original, so
+// shared references (and cycles) are copied once.
+struct gc_arena_promote {
+  struct gc_arena *arena;
+  mrb_value root;
+  struct gc_arena_promote_entry {
+    struct RBasic *from;
+    struct RBasic *to;
+  } *map;
+  size_t count;
+  size_t capa;
+
+  // Copies whose contents have yet to be filled in, and hashes which must be
+  // rehashed once all of their keys have been filled in.
+  struct gc_arena_promote_entry *pending;
+  size_t pending_count;
+  size_t pending_capa;
+  struct gc_arena_promote_entry *rehash;
+  size_t rehash_count;
+  size_t rehash_capa;
+
+  struct gc_arena_load_pair *pairs;
+  size_t pair_count;
+  size_t pair_capa;
+  const char *error;
+};
+
+struct gc_arena_overflow_call {
+  struct gc_arena *arena;
+  size_t objects;
+  size_t storage;
+};
+
+struct gc_arena_each {
+  struct gc_arena *arena;
+  void *caller;
+  mrb_value items;
+  mrb_value block;
+  mrb_value results;
+};
+
+enum gc_arena_collection_type {
+  GC_ARENA_COLLECTION_ARRAY,
+  GC_ARENA_COLLECTION_HASH,
+  GC_ARENA_COLLECTION_STRING,
+};
+
+struct gc_arena_collection {
+  enum gc_arena_collection_type type;
+  mrb_int capacity;
+  mrb_value items;
   mrb_value block;
-  mrb_gc original_gc;
-  void *original_allocf_ud;
 };
 
 #pragma endregion
@@ -62,426 +600,4042 @@ struct drb_api_t *api;
 static void gc_arena_free(mrb_state *mrb, void *ptr);
 const mrb_data_type gc_arena_data_type = {"Arena", gc_arena_free};
 
-static uint8_t gc_arena_count = 0;
-static struct gc_arena gc_arenas[MAX_ARENAS] = {0};
+static void gc_arena_ring_free(mrb_state *mrb, void *ptr);
+const mrb_data_type gc_arena_ring_data_type = {"Arena::Ring", gc_arena_ring_free};
+
+static void gc_arena_savepoint_free(mrb_state *mrb, void *ptr);
+const mrb_data_type gc_arena_savepoint_data_type = {"Arena::Mark", gc_arena_savepoint_free};
+
+// Arenas allocated without an mrb_state (as by tools and tests) are kept in a
+// shared registry, which falls back to `fallback_allocf`.
+static struct gc_arena_registry gc_arena_default_registry = {.registry = &gc_arena_default_registry};
 static mrb_allocf fallback_allocf;
 
-#define arena_ptr(ptr) (struct gc_arena *)(ptr)
-#define is_arena(ptr) (arena_ptr(ptr) >= &gc_arenas[0] && arena_ptr(ptr) < &gc_arenas[MAX_ARENAS])
+#define block_capa(idx) ((size_t)GC_ARENA_BLOCK_SIZE << (idx))
+
+static inline struct gc_arena_registry *gc_arena_registry(void *ud) {
+  return ud ? *(struct gc_arena_registry **)ud : &gc_arena_default_registry;
+}
+
+static inline struct gc_arena_registry *gc_arena_registry_for(mrb_state *mrb) {
+  return gc_arena_registry(mrb ? mrb->allocf_ud : NULL);
+}
+
+// Whether an allocator's `ud` (NULL, a registry, or one of its descriptors)
+// is a live Arena of the registry. Retired descriptors have no pages, and are
+// not considered live Arenas.
+static inline mrb_bool is_arena(struct gc_arena_registry *registry, void *ptr) {
+  struct gc_arena *arena = ptr;
+  return arena && ptr != registry && arena->registry == registry && arena->page != NULL;
+}
+
+// Returns the Arena the state is evaluating within, if any.
+static inline struct gc_arena *gc_arena_active(mrb_state *mrb) {
+  void *ud = mrb->allocf_ud;
+  return is_arena(gc_arena_registry(ud), ud) ? ud : NULL;
+}
+
+static inline void *gc_arena_fallback(struct gc_arena_registry *registry, mrb_state *mrb, void *ptr, size_t size) {
+  if (registry->allocf) return registry->allocf(mrb, ptr, size, registry->allocf_ud);
+  return fallback_allocf(mrb, ptr, size, NULL);
+}
+
+#pragma endregion
+
+#pragma region Tracing
+
+#ifdef GC_ARENA_TRACE
+// Tracing state is kept per thread, so that states running on separate threads
+// neither race on it nor interleave their records.
+static _Thread_local uint32_t gc_arena_trace_arenas = 0;
+static _Thread_local FILE *gc_arena_trace_file = NULL;
+static _Thread_local uint8_t gc_arena_trace_buffer[GC_ARENA_TRACE_RECORD_SIZE * 512];
+static _Thread_local size_t gc_arena_trace_buffered = 0;
+static _Thread_local uint32_t gc_arena_trace_ids = 0;
+
+// Open-addressed map of live traced pointers to their ids.
+struct gc_arena_trace_entry {
+  void *ptr;
+  uint32_t id;
+};
+static _Thread_local struct gc_arena_trace_entry *gc_arena_trace_map = NULL;
+static _Thread_local size_t gc_arena_trace_map_count = 0;
+static _Thread_local size_t gc_arena_trace_map_capa = 0;
+
+#define TRACE(op, arena, id, size) \
+  do { \
+    if (gc_arena_trace_file) gc_arena_trace(op, arena, id, size); \
+  } while (0)
+
+static void gc_arena_trace_flush(void) {
+  fwrite(gc_arena_trace_buffer, 1, gc_arena_trace_buffered, gc_arena_trace_file);
+  gc_arena_trace_buffered = 0;
+}
+
+static void gc_arena_trace(enum gc_arena_trace_op op, struct gc_arena *arena, uint32_t id, uint64_t size) {
+  if (gc_arena_trace_buffered == sizeof(gc_arena_trace_buffer)) gc_arena_trace_flush();
+
+  uint8_t *record = gc_arena_trace_buffer + gc_arena_trace_buffered;
+  record[0] = op;
+  for (int idx = 0; idx < 4; idx++) record[1 + idx] = arena->trace_id >> (idx * 8);
+  for (int idx = 0; idx < 4; idx++) record[5 + idx] = id >> (idx * 8);
+  for (int idx = 0; idx < 8; idx++) record[9 + idx] = size >> (idx * 8);
+  gc_arena_trace_buffered += GC_ARENA_TRACE_RECORD_SIZE;
+}
+
+static inline size_t gc_arena_trace_slot(void *ptr) {
+  return ((uintptr_t)ptr >> 3) * 0x9E3779B97F4A7C15ull & (gc_arena_trace_map_capa - 1);
+}
+
+// Maps the pointer to the given id, replacing any stale entry.
+static uint32_t gc_arena_trace_insert(void *ptr, uint32_t id) {
+  if ((gc_arena_trace_map_count + 1) * 2 > gc_arena_trace_map_capa) {
+    struct gc_arena_trace_entry *old = gc_arena_trace_map;
+    size_t old_capa = gc_arena_trace_map_capa;
+    gc_arena_trace_map_capa = old_capa ? old_capa * 2 : 4096;
+    gc_arena_trace_map = calloc(gc_arena_trace_map_capa, sizeof(struct gc_arena_trace_entry));
+    gc_arena_trace_map_count = 0;
+
+    for (size_t idx = 0; idx < old_capa; idx++) {
+      if (!old[idx].ptr) continue;
+      size_t slot = gc_arena_trace_slot(old[idx].ptr);
+      while (gc_arena_trace_map[slot].ptr) slot = (slot + 1) & (gc_arena_trace_map_capa - 1);
+      gc_arena_trace_map[slot] = old[idx];
+      gc_arena_trace_map_count++;
+    }
+    free(old);
+  }
+
+  size_t slot = gc_arena_trace_slot(ptr);
+  while (gc_arena_trace_map[slot].ptr && gc_arena_trace_map[slot].ptr != ptr) {
+    slot = (slot + 1) & (gc_arena_trace_map_capa - 1);
+  }
+
+  if (!gc_arena_trace_map[slot].ptr) gc_arena_trace_map_count++;
+  gc_arena_trace_map[slot] = (struct gc_arena_trace_entry){.ptr = ptr, .id = id};
+  return id;
+}
+
+#define gc_arena_trace_assign(ptr) gc_arena_trace_insert(ptr, gc_arena_trace_ids++)
+
+// Finds the id for a pointer (optionally forgetting it), or UINT32_MAX if the
+// pointer was allocated before tracing began.
+static uint32_t gc_arena_trace_lookup(void *ptr, mrb_bool forget) {
+  if (!gc_arena_trace_map_capa) return UINT32_MAX;
+
+  size_t mask = gc_arena_trace_map_capa - 1;
+  size_t slot = gc_arena_trace_slot(ptr);
+  while (gc_arena_trace_map[slot].ptr != ptr) {
+    if (!gc_arena_trace_map[slot].ptr) return UINT32_MAX;
+    slot = (slot + 1) & mask;
+  }
+
+  uint32_t id = gc_arena_trace_map[slot].id;
+  if (!forget) return id;
+
+  // Shift later entries back to fill the gap, keeping probe chains intact.
+  size_t next = slot;
+  while (1) {
+    gc_arena_trace_map[slot].ptr = NULL;
+    do {
+      next = (next + 1) & mask;
+      if (!gc_arena_trace_map[next].ptr) {
+        gc_arena_trace_map_count--;
+        return id;
+      }
+    } while (((next - gc_arena_trace_slot(gc_arena_trace_map[next].ptr)) & mask) < ((next - slot) & mask));
+
+    gc_arena_trace_map[slot] = gc_arena_trace_map[next];
+    slot = next;
+  }
+}
+
+static void gc_arena_trace_new(struct gc_arena *arena) {
+  struct gc_arena_page *first = (struct gc_arena_page *)arena->heap - 1;
+  void *end = first->limit ? first->floor : first->end;
+  TRACE(GC_ARENA_TRACE_NEW, arena, arena->initial_objects, end - arena->frontier_end);
+}
+
+// Assigns a newly created Arena its trace id, introducing it to any trace.
+static void gc_arena_trace_created(struct gc_arena *arena) {
+  arena->trace_id = gc_arena_trace_arenas++;
+  gc_arena_trace_new(arena);
+}
+
+static mrb_bool gc_arena_trace_start(struct gc_arena_registry *registry, const char *path) {
+  if (gc_arena_trace_file) return FALSE;
+
+  gc_arena_trace_file = fopen(path, "wb");
+  if (!gc_arena_trace_file) return FALSE;
+
+  uint8_t version[4] = {GC_ARENA_TRACE_VERSION};
+  fwrite(GC_ARENA_TRACE_MAGIC, 1, 4, gc_arena_trace_file);
+  fwrite(version, 1, 4, gc_arena_trace_file);
+
+  // Arenas allocated before tracing began are introduced up front.
+  for (uint8_t idx = 0; idx < registry->block_count; idx++) {
+    size_t used = idx == registry->block_count - 1 ? registry->block_used : block_capa(idx);
+    for (size_t arena = 0; arena < used; arena++) {
+      if (registry->blocks[idx][arena].page) gc_arena_trace_new(&registry->blocks[idx][arena]);
+    }
+  }
+
+  return TRUE;
+}
+
+static void gc_arena_trace_stop(void) {
+  if (!gc_arena_trace_file) return;
+
+  gc_arena_trace_flush();
+  fclose(gc_arena_trace_file);
+  gc_arena_trace_file = NULL;
+
+  free(gc_arena_trace_map);
+  gc_arena_trace_map = NULL;
+  gc_arena_trace_map_count = 0;
+  gc_arena_trace_map_capa = 0;
+}
+#else
+#define TRACE(op, arena, id, size)
+#define gc_arena_trace_created(arena)
+#endif
 
 #pragma endregion
 
 #pragma region Implementation
 
-static void gc_arena_free(mrb_state *mrb, void *ptr) {
-  struct gc_arena *arena = ptr;
-  struct gc_arena_page *page = arena->page;
-  struct gc_arena_page *next;
+#define round_up(size, align) (((size) + (align) - 1) & ~((size_t)(align) - 1))
 
-  do {
-    next = page->next;
-    free(page);
-  } while ((page = next));
+static void *gc_arena_vm_reserve(size_t size, mrb_bool huge_pages) {
+#ifdef _WIN32
+  return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+
+  // Huge pages must be aligned, so we over-reserve and trim the excess.
+  size_t span = size + (huge_pages ? GC_ARENA_VM_CHUNK : 0);
+  void *ptr = mmap(NULL, span, PROT_NONE, flags, -1, 0);
+  if (ptr == MAP_FAILED) return NULL;
+
+  if (huge_pages) {
+    void *aligned = (void *)round_up((uintptr_t)ptr, GC_ARENA_VM_CHUNK);
+    if (aligned > ptr) munmap(ptr, aligned - ptr);
+    if (ptr + span > aligned + size) munmap(aligned + size, ptr + span - (aligned + size));
+    ptr = aligned;
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  return ptr;
+#endif
 }
 
-static inline struct gc_arena_page *is_in_arena(struct gc_arena *arena, void *ptr) {
-  if (!is_arena(arena) || ptr < arena->beg || ptr >= arena->end) return NULL;
-  struct gc_arena_page *page = arena->page;
-  struct gc_arena_page *next;
-  do {
-    if (ptr >= page->start && ptr < page->end) break;
-    next = page->next;
-  } while ((page = next));
+static mrb_bool gc_arena_vm_commit(void *ptr, size_t size) {
+#ifdef _WIN32
+  return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+  return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
 
-  return page;
+// Returns the physical memory backing a range, leaving it committed.
+static void gc_arena_vm_discard(void *ptr, size_t size) {
+#ifdef _WIN32
+  VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+#else
+  madvise(ptr, size, MADV_DONTNEED);
+#endif
 }
 
-static inline void gc_arena_stats(mrb_state *mrb, struct gc_arena *arena, struct gc_arena_stats *stats) {
-  *stats = (struct gc_arena_stats){
-    .total_objects = arena->gc.live,
-    .live_objects = arena->gc.live,
-  };
+static void gc_arena_vm_release(void *ptr, size_t size) {
+#ifdef _WIN32
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, size);
+#endif
+}
 
-  struct gc_arena_page *page = arena->page;
-  while (page) {
-    stats->pages += 1;
-    stats->total_storage += page->end - page->start;
-    stats->free_storage += page->end - page->ptr;
-    stats->used_storage += page->ptr - page->start;
-    page = page->next;
+// Maps a file into private, writable memory; changes are never written back.
+static void *gc_arena_image_map(const char *path, size_t *size) {
+#ifdef _WIN32
+  FILE *file = fopen(path, "rb");
+  if (!file) return NULL;
+
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  void *ptr = malloc(*size);
+  if (ptr && fread(ptr, 1, *size, file) != *size) {
+    free(ptr);
+    ptr = NULL;
+  }
+  fclose(file);
+  return ptr;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat info;
+  void *ptr = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    *size = info.st_size;
+    ptr = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
   }
+  close(fd);
+  return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+static void gc_arena_image_unmap(void *ptr, size_t size) {
+#ifdef _WIN32
+  free(ptr);
+#else
+  munmap(ptr, size);
+#endif
+}
+
+// The bytes of storage spent on preallocated object slots (and the headers of
+// their heap pages), which are counted as objects rather than storage.
+static inline size_t gc_arena_object_overhead(struct gc_arena *arena) {
+  size_t overhead = sizeof(ObjectSlot) * arena->initial_objects;
+  overhead += (arena->frontier_end - (void *)arena->heap) / GC_ARENA_CHUNK_BYTES * (GC_ARENA_CHUNK_BYTES - GC_ARENA_HEAP_SLOTS * sizeof(ObjectSlot));
+  return overhead;
+}
+
+// The bytes of storage the Arena may still add before reaching its limit.
+static inline size_t gc_arena_storage_budget(struct gc_arena *arena) {
+  if (!arena->max_storage) return SIZE_MAX;
+
+  size_t storage = arena->counters.storage - gc_arena_object_overhead(arena);
+  return storage < arena->max_storage ? arena->max_storage - storage : 0;
+}
+
+// Commits enough of a reserved page to extend it to at least `end`, without
+// exceeding the Arena's storage limit.
+static inline mrb_bool gc_arena_vm_extend(struct gc_arena *arena, struct gc_arena_page *page, void *end) {
+  if (!page->limit || end > page->limit) return FALSE;
+
+  void *committed = (void *)page + round_up((size_t)(end - (void *)page), GC_ARENA_VM_CHUNK);
+  if (committed > page->limit) committed = page->limit;
+
+  size_t budget = gc_arena_storage_budget(arena);
+  if (committed - page->end > budget) committed = (void *)((uintptr_t)(page->end + budget) & ~(uintptr_t)4095);
+  if (committed < end || !gc_arena_vm_commit(page->end, committed - page->end)) return FALSE;
+
+  arena->counters.storage += committed - page->end;
+  page->end = committed;
+  return TRUE;
+}
 
-  struct mrb_heap_page *heap = arena->gc.free_heaps;
-  while (heap) {
-    struct RCptr *ptr = (struct RCptr *)heap->freelist;
-    while (ptr) {
-      stats->total_objects++;
-      stats->free_objects++;
-      ptr = ptr->p;
+// Finds the index of the first range starting above `ptr`.
+static inline size_t gc_arena_index_bound(struct gc_arena_registry *registry, void *ptr) {
+  size_t lo = 0;
+  size_t hi = registry->range_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (registry->ranges[mid].start <= ptr) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
+  }
+
+  return lo;
+}
+
+static inline struct gc_arena_range *gc_arena_index_find(struct gc_arena_registry *registry, void *ptr) {
+  size_t idx = gc_arena_index_bound(registry, ptr);
+  if (idx == 0) return NULL;
 
-    heap = heap->free_next;
+  struct gc_arena_range *range = &registry->ranges[idx - 1];
+  return ptr < range->end ? range : NULL;
+}
+
+// Drops the ranges left behind by released pages.
+static void gc_arena_index_compact(struct gc_arena_registry *registry) {
+  size_t count = 0;
+  for (size_t idx = 0; idx < registry->range_count; idx++) {
+    if (registry->ranges[idx].page) registry->ranges[count++] = registry->ranges[idx];
   }
 
-  stats->total_storage -= sizeof(ObjectSlot) * stats->total_objects;
-  stats->used_storage -= sizeof(ObjectSlot) * stats->total_objects;
+  registry->range_count = count;
+  registry->range_tombstones = 0;
 }
 
-static inline void *add_page(struct gc_arena *arena, size_t size) {
-  size_t page_size = size + sizeof(ObjectSlot) * 1024;
-  struct gc_arena_page *new = malloc(sizeof(struct gc_arena_page) + page_size);
-  *new = (struct gc_arena_page){
-    .start = new + 1,
-    .next = arena->page,
-    .ptr = new + 1,
-    .end = (void *)(new + 1) + page_size,
+// @NOTE Empty ranges are dropped before each insertion, so that a new page can
+//       never be hidden by the remains of an old one within its range.
+static void gc_arena_index_insert(struct gc_arena *arena, struct gc_arena_page *page) {
+  struct gc_arena_registry *registry = arena->registry;
+  if (registry->range_tombstones) gc_arena_index_compact(registry);
+  if (registry->range_count == registry->range_capa) {
+    registry->range_capa = registry->range_capa ? registry->range_capa * 2 : 64;
+    registry->ranges = realloc(registry->ranges, sizeof(struct gc_arena_range) * registry->range_capa);
+  }
+
+  size_t idx = gc_arena_index_bound(registry, page->start);
+  struct gc_arena_range *range = &registry->ranges[idx];
+  memmove(range + 1, range, sizeof(struct gc_arena_range) * (registry->range_count - idx));
+  *range = (struct gc_arena_range){
+    .start = page->start,
+    .end = page->limit ? page->limit : page->end,
+    .arena = arena,
+    .page = page,
   };
+  registry->range_count++;
+}
 
-  if (arena->beg > new->ptr) arena->beg = new->ptr;
-  if (arena->end < new->end) arena->end = new->end;
+// Empties a released page's range, compacting the index once half of its
+// ranges are empty.
+static void gc_arena_index_remove(struct gc_arena_registry *registry, struct gc_arena_page *page) {
+  struct gc_arena_range *range = &registry->ranges[gc_arena_index_bound(registry, page->start) - 1];
+  *range = (struct gc_arena_range){.start = range->start, .end = range->start};
+  if (++registry->range_tombstones * 2 >= registry->range_count) gc_arena_index_compact(registry);
+}
 
-  arena->page = new;
-  return new;
+// Frees a list of pages, removing them from the index.
+static void gc_arena_free_pages(struct gc_arena *arena, struct gc_arena_page *pages) {
+  struct gc_arena_page *page, *next;
+  for (page = pages; page; page = next) {
+    next = page->next;
+    gc_arena_index_remove(arena->registry, page);
+    if (page->limit) {
+      gc_arena_vm_release(page, page->limit - (void *)page);
+    } else if (!page->shared) {
+      free(page);
+    }
+  }
+}
+
+// Frees the Arena's fallback pages.
+static void gc_arena_free_fallback(mrb_state *mrb, struct gc_arena *arena) {
+  struct gc_arena_page *page, *next;
+  for (page = arena->fallback; page; page = next) {
+    next = page->next;
+    gc_arena_index_remove(arena->registry, page);
+    gc_arena_fallback(arena->registry, mrb, page, 0);
+  }
+
+  arena->fallback = NULL;
+  arena->fallback_storage = 0;
+}
+
+static void gc_arena_set_recycle(struct gc_arena *arena, mrb_bool recycle) {
+  arena->recycle = recycle;
+  arena->bump_below = recycle ? 0 : GC_ARENA_HEAP_BYTES;
 }
 
-void *alloc_with_arena(struct gc_arena *arena, size_t size) {
-  struct gc_arena_page *page = arena->page;
-  size_t tagged_size = size + sizeof(uint64_t) + (8 - size & 7) % 8;
+// Invalidates the Arena's savepoints newer than `keep` (or every savepoint, if
+// `keep` is NULL).
+static void gc_arena_savepoint_drop(struct gc_arena *arena, struct gc_arena_savepoint *keep) {
+  struct gc_arena_savepoint *savepoint = arena->savepoints;
+  while (savepoint != keep) {
+    struct gc_arena_savepoint *older = savepoint->older;
+    *savepoint = (struct gc_arena_savepoint){.mark = savepoint->mark};
+    savepoint = older;
+  }
+
+  if (keep) keep->newer = NULL;
+  arena->savepoints = keep;
+}
+
+static void gc_arena_free(mrb_state *mrb, void *ptr) {
+  struct gc_arena *arena = ptr;
+  struct gc_arena_page *page = arena->page;
+  TRACE(GC_ARENA_TRACE_DESTROY, arena, 0, 0);
+
+  while (page->next) {
+    page = page->next;
+  }
+
+  page->next = arena->spare;
+  while (page->next) {
+    page = page->next;
+  }
+
+  page->next = arena->object_spare;
+  while (page->next) {
+    page = page->next;
+  }
+
+  page->next = arena->run_spare;
+  while (page->next) {
+    page = page->next;
+  }
+
+  page->next = arena->run_page;
+  while (page->next) {
+    page = page->next;
+  }
+
+  page->next = arena->object_page;
+  gc_arena_free_pages(arena, arena->page);
+  if (arena->fallback) gc_arena_free_fallback(mrb, arena);
+  gc_arena_set_recycle(arena, FALSE);
+  if (arena->image) gc_arena_image_unmap(arena->image, arena->image_size);
+
+  // Retire the descriptor for reuse, along with its savepoints.
+  gc_arena_savepoint_drop(arena, NULL);
+  struct gc_arena_registry *registry = arena->registry;
+  *arena = (struct gc_arena){.registry = registry, .next_free = registry->free_list};
+  registry->free_list = arena;
+}
+
+static inline struct gc_arena_page *is_in_arena(struct gc_arena *arena, void *ptr) {
+  if (!is_arena(arena->registry, arena)) return NULL;
+  struct gc_arena_range *range = gc_arena_index_find(arena->registry, ptr);
+  return range && range->arena == arena ? range->page : NULL;
+}
+
+static inline void gc_arena_track_peaks(struct gc_arena *arena) {
+  if (arena->gc.live > arena->peak_live_objects) arena->peak_live_objects = arena->gc.live;
+  if (arena->counters.pages > arena->peak_pages) arena->peak_pages = arena->counters.pages;
+
+  // Object slots are not counted as storage.
+  size_t used = arena->counters.used - gc_arena_object_overhead(arena);
+  if (used > arena->peak_used_storage) arena->peak_used_storage = used;
+}
+
+// Reads the Arena's running totals; this takes constant time regardless of the
+// Arena's size.
+static inline void gc_arena_stats(mrb_state *mrb, struct gc_arena *arena, struct gc_arena_stats *stats) {
+  struct gc_arena_counters *counters = &arena->counters;
+  struct gc_arena_page *first = (struct gc_arena_page *)arena->heap - 1;
+  size_t overhead = gc_arena_object_overhead(arena);
+
+  // Efficiency is the share of storage consumed so far (used, or skipped over)
+  // that still holds live blocks, in parts per thousand.
+  size_t consumed = counters->used - overhead + counters->skipped;
+  size_t wasted = counters->abandoned + counters->freed + counters->skipped;
+
+  gc_arena_track_peaks(arena);
+  *stats = (struct gc_arena_stats){
+    .pages = counters->pages,
+    .average_page_size = counters->pages > 1 ? counters->overflow / (counters->pages - 1) : 0,
+    .total_objects = counters->objects + counters->fallback_objects,
+    .live_objects = arena->gc.live,
+    .free_objects = counters->objects + counters->fallback_objects - arena->gc.live,
+    .total_storage = counters->storage - overhead,
+    .used_storage = counters->used - overhead,
+    .free_storage = counters->storage - counters->used,
+    .retained_storage = arena->spare_bytes,
+    .reserved_storage = first->limit ? first->limit - first->start : 0,
+    .header_storage = counters->headers,
+    .padding_storage = counters->padding,
+    .abandoned_storage = counters->abandoned,
+    .freed_storage = counters->freed,
+    .skipped_storage = counters->skipped,
+    .storage_efficiency = consumed ? (consumed - wasted) * 1000 / consumed : 1000,
+    .object_pages = counters->object_pages,
+    .object_storage = counters->object_storage,
+    .deduplicated_storage = counters->deduplicated,
+    .max_objects = arena->max_objects,
+    .max_storage = arena->max_storage,
+    .overflows = arena->overflows,
+    .fallback_objects = counters->fallback_objects,
+    .fallback_storage = arena->fallback_storage,
+    .peak_live_objects = arena->peak_live_objects,
+    .peak_used_storage = arena->peak_used_storage,
+    .peak_pages = arena->peak_pages,
+  };
+}
+
+static inline size_t gc_arena_next_page_size(struct gc_arena_growth *growth, size_t size) {
+  if (growth->mode == GC_ARENA_GROWTH_FIXED) return size + growth->page_size;
+
+  size_t page_size = growth->next_page_size;
+  if (page_size < growth->max_page_size) {
+    growth->next_page_size = page_size * growth->factor;
+    if (growth->next_page_size > growth->max_page_size) growth->next_page_size = growth->max_page_size;
+  }
+
+  return size > page_size ? size + growth->page_size : page_size;
+}
+
+#define page_capa(page) ((size_t)((page)->end - (page)->start))
+
+static inline struct gc_arena_page *gc_arena_page_new(struct gc_arena *arena, size_t page_size) {
+  struct gc_arena_page *new = malloc(sizeof(struct gc_arena_page) + page_size);
+  *new = (struct gc_arena_page){
+    .start = new + 1,
+    .ptr = new + 1,
+    .end = (void *)(new + 1) + page_size,
+  };
+
+  gc_arena_index_insert(arena, new);
+  return new;
+}
+
+// Takes the first page retained in `list` large enough to hold `size` bytes,
+// but no larger than `max_size` bytes.
+static inline struct gc_arena_page *gc_arena_take_spare(struct gc_arena *arena, struct gc_arena_page **list, size_t size, size_t max_size) {
+  struct gc_arena_page **link = list;
+  while (*link && (page_capa(*link) < size || page_capa(*link) > max_size)) {
+    link = &(*link)->next;
+  }
+
+  struct gc_arena_page *page = *link;
+  if (!page) return NULL;
+
+  *link = page->next;
+  arena->spare_bytes -= page_capa(page);
+  page->ptr = page->start;
+  page->last = NULL;
+  page->run_size = 0;
+  return page;
+}
+
+// Adds a page with room for at least `size` bytes, or returns NULL if that
+// would take the Arena beyond its storage limit.
+static inline void *add_page(struct gc_arena *arena, size_t size) {
+  // Reserved pages grow in place, until their reservation is exhausted.
+  if (gc_arena_vm_extend(arena, arena->page, arena->page->ptr + size)) return arena->page;
+
+  // New pages are trimmed to fit within the storage limit.
+  size_t budget = gc_arena_storage_budget(arena);
+  if (size > budget) return NULL;
+
+  struct gc_arena_page *new = gc_arena_take_spare(arena, &arena->spare, size, budget);
+  if (!new) {
+    size_t page_size = gc_arena_next_page_size(&arena->growth, size);
+    new = gc_arena_page_new(arena, page_size < budget ? page_size : budget);
+  }
+
+  arena->counters.pages += 1;
+  arena->counters.storage += page_capa(new);
+  arena->counters.overflow += page_capa(new);
+  arena->counters.skipped += arena->page->end - arena->page->ptr;
+
+  new->next = arena->page;
+  arena->page = new;
+  return new;
+}
+
+// Adds an object page with room for at least `chunks` heap pages, sized by the
+// Arena's object growth policy (within its object limit).
+static struct gc_arena_page *gc_arena_add_object_page(struct gc_arena *arena, size_t chunks) {
+  size_t min_size = GC_ARENA_CHUNK_BYTES * chunks;
+  size_t size = gc_arena_next_page_size(&arena->object_growth, min_size);
+  size -= size % GC_ARENA_CHUNK_BYTES;
+  if (arena->max_objects) {
+    size_t limit = (arena->max_objects - arena->counters.objects) / GC_ARENA_HEAP_SLOTS * GC_ARENA_CHUNK_BYTES;
+    if (size > limit) size = limit;
+  }
+  if (size < min_size) size = min_size;
+
+  struct gc_arena_page *page = gc_arena_take_spare(arena, &arena->object_spare, min_size, SIZE_MAX);
+  if (!page) page = gc_arena_page_new(arena, size);
+
+  arena->counters.object_pages += 1;
+  arena->counters.object_storage += page_capa(page);
+
+  page->next = arena->object_page;
+  arena->object_page = page;
+  return page;
+}
+
+// Carves a tagged mruby heap page from the current object page.
+static inline void *gc_arena_take_chunk(struct gc_arena *arena) {
+  struct gc_arena_page *page = arena->object_page;
+  if (!page || page->end - page->ptr < GC_ARENA_CHUNK_BYTES) page = gc_arena_add_object_page(arena, 1);
+
+  uint64_t *heap = page->ptr;
+  page->ptr += GC_ARENA_CHUNK_BYTES;
+  heap[0] = GC_ARENA_HEAP_BYTES;
+  return heap + 1;
+}
+
+void *alloc_with_arena(struct gc_arena *arena, size_t size) {
+  struct gc_arena_page *page = arena->page;
+  size_t tagged_size = size + sizeof(uint64_t) + (8 - size & 7) % 8;
+
+  if (tagged_size > page->end - page->ptr) {
+    page = add_page(arena, tagged_size);
+    if (!page) return NULL;
+  }
+
+  uint64_t *tag = page->ptr;
+  page->last = tag + 1;
+  PROFILE(arena->profile.sizes[size > 1 ? 64 - __builtin_clzll(size - 1) : 0]++);
+
+  *tag = size;
+  page->ptr += tagged_size;
+  arena->counters.used += tagged_size;
+  arena->counters.headers += sizeof(uint64_t);
+  arena->counters.padding += tagged_size - sizeof(uint64_t) - size;
+  return page->last;
+}
+
+static inline uint64_t gc_arena_intern_hash(const char *ptr, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t idx = 0; idx < len; idx++) hash = (hash ^ (uint8_t)ptr[idx]) * 1099511628211ULL;
+  return hash;
+}
+
+// Finds the interned string with the given contents, if any.
+static struct RString *gc_arena_intern_find(struct gc_arena *arena, const char *ptr, size_t len, uint64_t hash) {
+  struct gc_arena_intern *table = arena->intern;
+  if (!table) return NULL;
+
+  for (size_t idx = hash & (table->capa - 1);; idx = (idx + 1) & (table->capa - 1)) {
+    struct gc_arena_intern_entry *entry = &table->entries[idx];
+    if (!entry->str) return NULL;
+
+    mrb_value str = mrb_obj_value(entry->str);
+    if (entry->hash == hash && RSTRING_LEN(str) == len && !memcmp(RSTRING_PTR(str), ptr, len)) return entry->str;
+  }
+}
+
+// Adds a string to the Arena's interning table, doubling the table when it is
+// half full; the outgrown table is abandoned. Returns FALSE if the table could
+// not grow within the Arena's limits.
+static mrb_bool gc_arena_intern_insert(struct gc_arena *arena, struct RString *str, uint64_t hash) {
+  struct gc_arena_intern *table = arena->intern;
+  if (!table || (table->count + 1) * 2 > table->capa) {
+    size_t capa = table ? table->capa * 2 : GC_ARENA_INTERN_CAPA;
+    size_t size = sizeof(struct gc_arena_intern) + sizeof(struct gc_arena_intern_entry) * capa;
+    struct gc_arena_intern *grown = alloc_with_arena(arena, size);
+    if (!grown) return FALSE;
+
+    memset(grown, 0, size);
+    grown->capa = capa;
+    arena->intern = grown;
+    if (table) {
+      for (size_t idx = 0; idx < table->capa; idx++) {
+        if (table->entries[idx].str) gc_arena_intern_insert(arena, table->entries[idx].str, table->entries[idx].hash);
+      }
+      arena->counters.abandoned += sizeof(uint64_t) + sizeof(struct gc_arena_intern) + sizeof(struct gc_arena_intern_entry) * table->capa;
+    }
+    table = grown;
+  }
+
+  size_t idx = hash & (table->capa - 1);
+  while (table->entries[idx].str) idx = (idx + 1) & (table->capa - 1);
+  table->entries[idx] = (struct gc_arena_intern_entry){.hash = hash, .str = str};
+  table->count++;
+  return TRUE;
+}
+
+static inline int gc_arena_size_class(size_t size) {
+  if (size <= GC_ARENA_SMALL_CLASSES * 8) return (size - 1) >> 3;
+  if (size > GC_ARENA_MAX_RECYCLED) return -1;
+
+  // Find `k` such that 2^k < size <= 2^(k+1), then the quarter step within.
+  int k = 63 - __builtin_clzll(size - 1);
+  return GC_ARENA_SMALL_CLASSES + (k - 8) * 4 + ((size - 1) - ((size_t)1 << k)) / ((size_t)1 << (k - 2));
+}
+
+static inline size_t gc_arena_class_size(int class) {
+  if (class < GC_ARENA_SMALL_CLASSES) return (size_t)(class + 1) << 3;
+
+  int k = (class - GC_ARENA_SMALL_CLASSES) / 4 + 8;
+  return ((size_t)1 << k) + ((size_t)((class - GC_ARENA_SMALL_CLASSES) % 4 + 1) << (k - 2));
+}
+
+// The usable size of a recycled block holding `size` bytes.
+static inline size_t gc_arena_block_capa(size_t size) {
+  int class = gc_arena_size_class(size);
+  return class < 0 ? size + (-size & 7) : gc_arena_class_size(class);
+}
+
+// The size of a block: its tag, or the size of its run's class.
+static inline size_t gc_arena_block_size(struct gc_arena_page *page, void *ptr) {
+  return page->run_size ? page->run_size : ((uint64_t *)ptr)[-1];
+}
+
+// Returns FALSE if the block is too large to be recycled. The small classes
+// are only served from runs, so tagged blocks of those sizes are never reused.
+static inline mrb_bool gc_arena_push_free(struct gc_arena *arena, struct gc_arena_page *page, void *ptr) {
+  int class = gc_arena_size_class(gc_arena_block_size(page, ptr));
+  if (class < 0 || (class < GC_ARENA_SMALL_CLASSES && !page->run_size)) return FALSE;
+
+  *(void **)ptr = arena->free_blocks[class];
+  arena->free_blocks[class] = ptr;
+  return TRUE;
+}
+
+// The storage held by a block which cannot be recycled, including its tag.
+static inline size_t gc_arena_block_storage(struct gc_arena_page *page, void *ptr) {
+  if (page->run_size) return page->run_size;
+
+  size_t size = ((uint64_t *)ptr)[-1];
+  return sizeof(uint64_t) + size + (-size & 7);
+}
+
+// Handles a block passed to free; storage is only reclaimed by Arenas in
+// recycling mode, and is otherwise counted as wasted.
+static inline void gc_arena_release_block(struct gc_arena_registry *registry, struct gc_arena *active, void *ptr) {
+  struct gc_arena *arena = active;
+  struct gc_arena_page *page = active->page;
+  if (ptr < page->start || ptr >= page->end) {
+    struct gc_arena_range *range = gc_arena_index_find(registry, ptr);
+    if (!range) return;
+
+    arena = range->arena;
+    page = range->page;
+  }
+
+  if (page->fallback || (arena->recycle && gc_arena_push_free(arena, page, ptr))) return;
+  arena->counters.freed += gc_arena_block_storage(page, ptr);
+}
+
+// Carves an untagged block from the current run of a small size class,
+// starting a new run page once that run is full.
+static void *gc_arena_take_run_block(struct gc_arena *arena, int class) {
+  size_t size = gc_arena_class_size(class);
+  struct gc_arena_page *page = arena->runs[class];
+  if (!page || page->end - page->ptr < size) {
+    if (GC_ARENA_RUN_BYTES > gc_arena_storage_budget(arena)) return NULL;
+    if (page) arena->counters.skipped += page->end - page->ptr;
+
+    page = gc_arena_take_spare(arena, &arena->run_spare, 0, SIZE_MAX);
+    if (!page) page = gc_arena_page_new(arena, GC_ARENA_RUN_BYTES);
+    page->run_size = size;
+    page->next = arena->run_page;
+    arena->run_page = page;
+    arena->runs[class] = page;
+
+    arena->counters.pages += 1;
+    arena->counters.storage += GC_ARENA_RUN_BYTES;
+    arena->counters.overflow += GC_ARENA_RUN_BYTES;
+  }
+
+  void *block = page->ptr;
+  PROFILE(arena->profile.sizes[64 - __builtin_clzll(size - 1)]++);
+
+  page->ptr += size;
+  arena->counters.used += size;
+  return block;
+}
+
+// Allocates from the free list for the size class, falling back to a new
+// class-sized block. Small blocks come from runs, and carry no size tag.
+void *alloc_recycled(struct gc_arena *arena, size_t size) {
+  int class = gc_arena_size_class(size);
+  uint64_t *block = class < 0 ? NULL : arena->free_blocks[class];
+  if (block) {
+    arena->free_blocks[class] = *(void **)block;
+  } else {
+    block = class >= 0 && class < GC_ARENA_SMALL_CLASSES ? gc_arena_take_run_block(arena, class) : alloc_with_arena(arena, gc_arena_block_capa(size));
+    if (!block) return NULL;
+    arena->counters.padding += gc_arena_block_capa(size) - size;
+  }
+
+  if (class < 0 || class >= GC_ARENA_SMALL_CLASSES) block[-1] = size;
+  return block;
+}
+
+// Allocates a tagged block aligned to `alignment` bytes (a power of two), for
+// data read with wide vector loads. Aligned blocks are sized like any other
+// (to their size class, when recycling), so they may be resized or freed by
+// the allocator; a block moved by reallocation is only 8-byte aligned.
+void *alloc_aligned(struct gc_arena *arena, size_t size, size_t alignment) {
+  if (alignment <= 8 && !arena->recycle) return alloc_with_arena(arena, size);
+  if (alignment < 8) alignment = 8;
+
+  struct gc_arena_page *page = arena->page;
+  size_t padded_size = arena->recycle ? gc_arena_block_capa(size) : size + (-size & 7);
+  void *block = (void *)round_up((uintptr_t)page->ptr + sizeof(uint64_t), alignment);
+
+  if (block + padded_size > page->end) {
+    page = add_page(arena, padded_size + sizeof(uint64_t) + alignment - 8);
+    if (!page) return NULL;
+    block = (void *)round_up((uintptr_t)page->ptr + sizeof(uint64_t), alignment);
+  }
+
+  size_t used = block + padded_size - page->ptr;
+  ((uint64_t *)block)[-1] = size;
+  page->last = block;
+  PROFILE(arena->profile.sizes[size > 1 ? 64 - __builtin_clzll(size - 1) : 0]++);
+
+  page->ptr = block + padded_size;
+  arena->counters.used += used;
+  arena->counters.headers += sizeof(uint64_t);
+  arena->counters.padding += used - sizeof(uint64_t) - size;
+  return block;
+}
+
+// Applies the Arena's overflow policy to an allocation that would exceed its
+// limits, returning NULL (which mruby raises as a NoMemoryError) unless the
+// allocation may fall back. Fallback allocations are carved from pages taken
+// from the fallback allocator, which are indexed like any other and freed when
+// the Arena is reset; blocks too large for a shared page get one of their own.
+// Hooks can't be called from within the allocator, so with a hook the
+// allocation falls back, and is recorded for `gc_arena_overflow_notify` to
+// report once the eval returns.
+//
+// @NOTE Fallback pages are never the target of in-place reallocation, so that
+//       the Arena's counters only ever describe its own pages.
+static void *gc_arena_overflow(mrb_state *mrb, struct gc_arena *arena, size_t size, size_t slots) {
+  arena->overflows++;
+  if (arena->on_overflow == GC_ARENA_OVERFLOW_RAISE) return NULL;
+
+  size_t capa = gc_arena_block_capa(size);
+  struct gc_arena_page *page = arena->fallback;
+  if (!page || sizeof(uint64_t) + capa > (size_t)(page->end - page->ptr)) {
+    size_t page_size = sizeof(uint64_t) + capa;
+    if (page_size < GC_ARENA_FALLBACK_PAGE_SIZE) page_size = GC_ARENA_FALLBACK_PAGE_SIZE;
+    page = gc_arena_fallback(arena->registry, mrb, NULL, sizeof(struct gc_arena_page) + page_size);
+    if (!page) return NULL;
+
+    *page = (struct gc_arena_page){
+      .next = arena->fallback,
+      .start = page + 1,
+      .ptr = page + 1,
+      .end = (void *)(page + 1) + page_size,
+      .fallback = TRUE,
+    };
+
+    // Pages of a single block are kept behind the shared page being filled.
+    if (page_size > GC_ARENA_FALLBACK_PAGE_SIZE && arena->fallback) {
+      page->next = arena->fallback->next;
+      arena->fallback->next = page;
+    } else {
+      arena->fallback = page;
+    }
+    gc_arena_index_insert(arena, page);
+  }
+
+  uint64_t *tag = page->ptr;
+  *tag = size;
+  page->ptr += sizeof(uint64_t) + capa;
+
+  arena->fallback_storage += sizeof(uint64_t) + capa;
+  arena->counters.fallback_objects += slots;
+  if (arena->on_overflow == GC_ARENA_OVERFLOW_HOOK) {
+    if (slots) arena->overflow_pending_objects += size;
+    else arena->overflow_pending_storage += size;
+  }
+  return tag + 1;
+}
+
+// Reallocates a block in a recycling Arena, or in a run page of any Arena.
+static void *realloc_recycled(mrb_state *mrb, struct gc_arena *arena, struct gc_arena_page *page, void *ptr, size_t size) {
+  size_t original_size = gc_arena_block_size(page, ptr);
+
+  // Resize in place if the block is already large enough, or if it is the
+  // most recent allocation on its page and can be extended.
+  size_t capa = gc_arena_block_capa(size);
+  if (size <= gc_arena_block_capa(original_size) || (ptr == page->last && ptr + capa <= page->end)) {
+    if (size > gc_arena_block_capa(original_size)) {
+      arena->counters.used += ptr + capa - page->ptr;
+      if (page != arena->page) arena->counters.skipped -= ptr + capa - page->ptr;
+      page->ptr = ptr + capa;
+    }
+    if (!page->run_size) ((uint64_t *)ptr)[-1] = size;
+    PROFILE(arena->profile.realloc_in_place++);
+    return ptr;
+  }
+
+  PROFILE(arena->profile.realloc_copied++);
+  void *dest = arena->recycle ? alloc_recycled(arena, size) : alloc_with_arena(arena, size);
+  if (!dest && !(dest = gc_arena_overflow(mrb, arena, size, 0))) return NULL;
+  memcpy(dest, ptr, original_size);
+  if (page->fallback || (arena->recycle && gc_arena_push_free(arena, page, ptr))) return dest;
+  arena->counters.abandoned += gc_arena_block_storage(page, ptr);
+  return dest;
+}
+
+static inline void *gc_arena_allocf_untraced(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
+  struct gc_arena_registry *registry = gc_arena_registry(ud);
+  mrb_bool active = is_arena(registry, ud);
+  if (!active && (!size || !ptr)) return gc_arena_fallback(registry, mrb, ptr, size);
+
+  // Handle free() calls.
+  if (size == 0) {
+    if (ptr) gc_arena_release_block(registry, ud, ptr);
+    return NULL;
+  }
+
+  // Handle malloc() calls.
+  if (ptr == NULL) {
+    struct gc_arena *arena = ud;
+    if (size < arena->bump_below) {
+      void *block = alloc_with_arena(arena, size);
+      return block ? block : gc_arena_overflow(mrb, arena, size, 0);
+    }
+
+    // New heap pages are served from the preallocated object slots first.
+    if (size == GC_ARENA_HEAP_BYTES && (!mrb || !mrb->gc.free_heaps)) {
+      if (arena->frontier < arena->frontier_end) {
+        uint64_t *heap = arena->frontier;
+        arena->frontier += GC_ARENA_CHUNK_BYTES;
+        heap[0] = size;
+        return heap + 1;
+      }
+
+      // Further heap pages are carved from the object pages.
+      if (arena->max_objects && arena->counters.objects + GC_ARENA_HEAP_SLOTS > arena->max_objects) {
+        return gc_arena_overflow(mrb, arena, size, GC_ARENA_HEAP_SLOTS);
+      }
+
+      void *heap = gc_arena_take_chunk(arena);
+      arena->counters.objects += GC_ARENA_HEAP_SLOTS;
+      return heap;
+    }
+
+    void *block = arena->recycle ? alloc_recycled(arena, size) : alloc_with_arena(arena, size);
+    return block ? block : gc_arena_overflow(mrb, arena, size, 0);
+  }
+
+  // Handle realloc() calls.
+  // Most reallocations target the current page of the active Arena; anything
+  // else is resolved through the address index.
+  struct gc_arena *arena = ud;
+  struct gc_arena_page *page;
+  if (active && ptr >= arena->page->start && ptr < arena->page->end) {
+    page = arena->page;
+  } else {
+    struct gc_arena_range *range = gc_arena_index_find(registry, ptr);
+    if (!range) return gc_arena_fallback(registry, mrb, ptr, size);
+
+    arena = range->arena;
+    page = range->page;
+  }
+
+  if (arena->recycle || page->run_size) return realloc_recycled(mrb, arena, page, ptr, size);
+
+  // Extend the pointer if there's enough space remaining on that page.
+  if (ptr == page->last && (ptr + size <= page->end || gc_arena_vm_extend(arena, page, ptr + size))) {
+    size_t original_size = ((uint64_t *)ptr)[-1];
+    ((uint64_t *)ptr)[-1] = size;
+    arena->counters.used += ptr + size + (-size & 7) - page->ptr;
+    arena->counters.padding += (-size & 7) - (size_t)(page->ptr - ptr - original_size);
+    if (page != arena->page) arena->counters.skipped -= ptr + size + (-size & 7) - page->ptr;
+    page->ptr = ptr + size + (8 - size & 7) % 8;
+    PROFILE(arena->profile.realloc_in_place++);
+    return ptr;
+  }
+
+  // Step 3: Allocate a new page and copy over the data.
+  PROFILE(arena->profile.realloc_copied++);
+  void *dest = alloc_with_arena(arena, size);
+  if (!dest && !(dest = gc_arena_overflow(mrb, arena, size, 0))) return NULL;
+  size_t original_size = ((uint64_t *)ptr)[-1];
+  memcpy(dest, ptr, size > original_size ? original_size : size);
+  if (!page->fallback) arena->counters.abandoned += gc_arena_block_storage(page, ptr);
+  return dest;
+}
+
+#ifdef GC_ARENA_TRACE
+// Records each allocation request served by an Arena, identifying blocks by
+// sequential ids rather than addresses.
+static void *gc_arena_allocf_traced(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
+  struct gc_arena_registry *registry = gc_arena_registry(ud);
+  struct gc_arena_range *range = ptr ? gc_arena_index_find(registry, ptr) : NULL;
+  struct gc_arena *arena = range ? range->arena : !ptr && is_arena(registry, ud) ? ud : NULL;
+  void *result = gc_arena_allocf_untraced(mrb, ptr, size, ud);
+  if (!arena) return result;
+
+  if (!ptr) {
+    TRACE(GC_ARENA_TRACE_MALLOC, arena, gc_arena_trace_assign(result), size);
+  } else {
+    uint32_t id = gc_arena_trace_lookup(ptr, TRUE);
+    if (id == UINT32_MAX) return result;
+
+    if (!size) {
+      TRACE(GC_ARENA_TRACE_FREE, arena, id, 0);
+    } else {
+      TRACE(GC_ARENA_TRACE_REALLOC, arena, id, size);
+      gc_arena_trace_insert(result, id);
+    }
+  }
+
+  return result;
+}
+#endif
+
+void *gc_arena_allocf(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
+#ifdef GC_ARENA_TRACE
+  if (gc_arena_trace_file) return gc_arena_allocf_traced(mrb, ptr, size, ud);
+#endif
+  return gc_arena_allocf_untraced(mrb, ptr, size, ud);
+}
+
+static void *gc_arena_initialize_heap(struct mrb_heap_page *heap, size_t count) {
+  ObjectSlot *slot = (ObjectSlot *)heap->objects;
+  ObjectSlot *prev = NULL;
+
+  while (count--) {
+    slot->as.ptr = (struct RCptr){.tt = MRB_TT_FREE, .p = prev};
+    prev = slot++;
+  }
+
+  return prev;
+}
+
+// Retains a page in `list` for reuse within the budget, or queues it to be
+// freed.
+static inline void gc_arena_release_page(struct gc_arena *arena, struct gc_arena_page **list, struct gc_arena_page *page, struct gc_arena_page **doomed) {
+  if (arena->spare_bytes + page_capa(page) <= arena->retain_bytes) {
+    page->next = *list;
+    *list = page;
+    arena->spare_bytes += page_capa(page);
+  } else {
+    page->next = *doomed;
+    *doomed = page;
+  }
+}
+
+// Replaces the pages retained in `list` with a single page of at least `size`
+// bytes.
+static void gc_arena_coalesce_list(struct gc_arena *arena, struct gc_arena_page **list, size_t size, struct gc_arena_page **doomed) {
+  struct gc_arena_page *spare = *list;
+  if (!size || (spare && !spare->next && page_capa(spare) >= size)) return;
+
+  while (spare) {
+    struct gc_arena_page *next = spare->next;
+    arena->spare_bytes -= page_capa(spare);
+    spare->next = *doomed;
+    *doomed = spare;
+    spare = next;
+  }
+
+  *list = gc_arena_page_new(arena, size);
+  arena->spare_bytes += size;
+}
+
+// Replaces the retained pages with one storage page large enough to hold the
+// largest overflow seen so far, and one object page large enough for the most
+// object pages used, within the retention budget (objects first).
+static void gc_arena_coalesce(struct gc_arena *arena, struct gc_arena_page **doomed) {
+  size_t objects = arena->object_high_water;
+  if (objects > arena->retain_bytes) objects = arena->retain_bytes - arena->retain_bytes % GC_ARENA_CHUNK_BYTES;
+  gc_arena_coalesce_list(arena, &arena->object_spare, objects, doomed);
+
+  size_t size = arena->overflow_high_water + arena->growth.page_size;
+  if (size > arena->retain_bytes - objects) size = arena->retain_bytes - objects;
+  if (arena->overflow_high_water) gc_arena_coalesce_list(arena, &arena->spare, size, doomed);
+}
+
+// The number of object slots threaded eagerly into the first heap page; the
+// remainder are handed out in whole heap pages as mruby requests them.
+static inline size_t gc_arena_eager_objects(size_t object_count) {
+  return object_count ? (object_count - 1) % GC_ARENA_HEAP_SLOTS + 1 : 0;
+}
+
+static inline size_t gc_arena_lazy_chunks(size_t object_count) {
+  return object_count ? (object_count - 1) / GC_ARENA_HEAP_SLOTS : 0;
+}
+
+// The number of object slots in one of the Arena's heap pages.
+static inline size_t gc_arena_heap_slots(struct gc_arena *arena, mrb_heap_page *heap) {
+  return heap == arena->heap ? gc_arena_eager_objects(arena->initial_objects) : GC_ARENA_HEAP_SLOTS;
+}
+
+static void gc_arena_reset(mrb_state *mrb, struct gc_arena *arena) {
+  mrb_heap_page *heap = arena->heap;
+  TRACE(GC_ARENA_TRACE_RESET, arena, 0, 0);
+  gc_arena_track_peaks(arena);
+
+  // Retain overflow pages within the budget, and free the rest.
+  struct gc_arena_page *page = arena->page;
+  struct gc_arena_page *doomed = NULL;
+  struct gc_arena_page *next;
+  size_t overflow = 0;
+  while (page->next) {
+    next = page->next;
+    overflow += page->ptr - page->start;
+    gc_arena_release_page(arena, &arena->spare, page, &doomed);
+    page = next;
+  }
+
+  if (overflow > arena->overflow_high_water) arena->overflow_high_water = overflow;
+  size_t object_bytes = 0;
+  for (struct gc_arena_page *objects = arena->object_page; objects; objects = next) {
+    next = objects->next;
+    object_bytes += objects->ptr - objects->start;
+    gc_arena_release_page(arena, &arena->object_spare, objects, &doomed);
+  }
+
+  if (object_bytes > arena->object_high_water) arena->object_high_water = object_bytes;
+  for (struct gc_arena_page *runs = arena->run_page; runs; runs = next) {
+    next = runs->next;
+    gc_arena_release_page(arena, &arena->run_spare, runs, &doomed);
+  }
+
+  arena->object_page = NULL;
+  arena->run_page = NULL;
+  if (arena->coalesce) gc_arena_coalesce(arena, &doomed);
+  if (doomed) gc_arena_free_pages(arena, doomed);
+  if (arena->fallback) gc_arena_free_fallback(mrb, arena);
+  memset(arena->free_blocks, 0, sizeof(arena->free_blocks));
+  memset(arena->runs, 0, sizeof(arena->runs));
+
+  if (page->limit && page->end > page->floor) gc_arena_vm_discard(page->floor, page->end - page->floor);
+
+  *heap = (mrb_heap_page){.freelist = gc_arena_initialize_heap(heap, gc_arena_eager_objects(arena->initial_objects))};
+
+  page->ptr = arena->frontier_end;
+  arena->frontier = (void *)(heap + 1) + sizeof(ObjectSlot) * gc_arena_eager_objects(arena->initial_objects);
+  arena->page = page;
+  arena->intern = NULL;
+  gc_arena_savepoint_drop(arena, NULL);
+  arena->counters = (struct gc_arena_counters){
+    .pages = 1,
+    .objects = arena->initial_objects,
+    .storage = page_capa(page),
+    .used = page->ptr - page->start,
+  };
+  arena->gc.live = 0;
+  arena->gc.sweeps = NULL;
+  arena->gc.heaps = heap;
+  arena->gc.free_heaps = heap;
+  arena->heaps_tail = heap;
+}
+
+static void gc_arena_mark(struct gc_arena *arena, struct gc_arena_mark *mark) {
+  mrb_heap_page *heap = arena->gc.free_heaps;
+  *mark = (struct gc_arena_mark){
+    .page = arena->page,
+    .ptr = arena->page->ptr,
+    .last = arena->page->last,
+    .heaps = arena->gc.heaps,
+    .heaps_tail = arena->heaps_tail,
+    .free_heaps = heap,
+    .free_next = heap ? heap->free_next : NULL,
+    .freelist = heap ? heap->freelist : NULL,
+    .frontier = arena->frontier,
+    .object_page = arena->object_page,
+    .object_ptr = arena->object_page ? arena->object_page->ptr : NULL,
+    .run_page = arena->run_page,
+    .live = arena->gc.live,
+    .committed = ((struct gc_arena_page *)arena->heap - 1)->end,
+    .counters = arena->counters,
+  };
+}
+
+// Rolls an Arena back to a previously captured mark, releasing any pages
+// allocated since.
+//
+// @NOTE Heap pages thread their freelist from the last slot down to the first,
+//       and slots are only ever taken from the head, so the slots consumed
+//       since the mark are exactly those between the marked and current heads.
+//       Any other heap pages free at the mark were reserved, untouched, and
+//       lie in order at the end of the heap list.
+static void gc_arena_rewind(struct gc_arena *arena, struct gc_arena_mark *mark) {
+  gc_arena_track_peaks(arena);
+
+  struct gc_arena_page *page = arena->page;
+  struct gc_arena_page *doomed = NULL;
+  struct gc_arena_page *next;
+  while (page != mark->page) {
+    next = page->next;
+    gc_arena_release_page(arena, &arena->spare, page, &doomed);
+    page = next;
+  }
+
+  for (struct gc_arena_page *objects = arena->object_page; objects != mark->object_page; objects = next) {
+    next = objects->next;
+    gc_arena_release_page(arena, &arena->object_spare, objects, &doomed);
+  }
+
+  for (struct gc_arena_page *runs = arena->run_page; runs != mark->run_page; runs = next) {
+    next = runs->next;
+    gc_arena_release_page(arena, &arena->run_spare, runs, &doomed);
+  }
+
+  arena->object_page = mark->object_page;
+  if (mark->object_page) mark->object_page->ptr = mark->object_ptr;
+  arena->run_page = mark->run_page;
+  if (doomed) gc_arena_free_pages(arena, doomed);
+
+  // Free lists (and the interning table) may refer to blocks above the mark.
+  // Runs started before the mark are left behind until the Arena is reset.
+  memset(arena->free_blocks, 0, sizeof(arena->free_blocks));
+  memset(arena->runs, 0, sizeof(arena->runs));
+  arena->intern = NULL;
+
+  page->ptr = mark->ptr;
+  page->last = mark->last;
+  arena->page = page;
+
+  mrb_heap_page *heap = mark->free_heaps;
+  if (heap) {
+    ObjectSlot *first = (ObjectSlot *)heap->objects;
+    ObjectSlot *stop = arena->gc.free_heaps == heap ? (ObjectSlot *)heap->freelist : NULL;
+    for (ObjectSlot *slot = mark->freelist; slot != stop; slot--) {
+      slot->as.ptr = (struct RCptr){.tt = MRB_TT_FREE, .p = slot == first ? NULL : slot - 1};
+      if (slot == first) break;
+    }
+
+    heap->freelist = mark->freelist;
+    heap->free_next = NULL;
+    heap->free_prev = NULL;
+  }
+
+  // Reserved heap pages are re-threaded if they've been used, and relinked.
+  mrb_heap_page *prev = heap;
+  for (mrb_heap_page *next = mark->free_next; next; next = next == mark->heaps_tail ? NULL : next->next) {
+    ObjectSlot *last = (ObjectSlot *)next->objects + GC_ARENA_HEAP_SLOTS - 1;
+    if (next->freelist != (void *)last) next->freelist = gc_arena_initialize_heap(next, GC_ARENA_HEAP_SLOTS);
+    next->free_prev = prev;
+    next->free_next = NULL;
+    prev->free_next = next;
+    prev = next;
+  }
+
+  // Heap pages reserved since the mark are dropped.
+  mark->heaps_tail->next = NULL;
+  arena->heaps_tail = mark->heaps_tail;
+  mark->heaps->prev = NULL;
+  arena->frontier = mark->frontier;
+  arena->counters = mark->counters;
+
+  // Memory committed since the mark remains committed.
+  struct gc_arena_page *first = (struct gc_arena_page *)arena->heap - 1;
+  arena->counters.storage += first->end - mark->committed;
+  arena->gc.heaps = mark->heaps;
+  arena->gc.free_heaps = heap;
+  arena->gc.live = mark->live;
+}
+
+// Captures a savepoint for the Arena. Savepoints are allocated outside of the
+// Arena, and released with `gc_arena_savepoint_free`.
+static struct gc_arena_savepoint *gc_arena_savepoint_new(struct gc_arena *arena) {
+  struct gc_arena_savepoint *savepoint = malloc(sizeof(struct gc_arena_savepoint));
+  *savepoint = (struct gc_arena_savepoint){.arena = arena, .older = arena->savepoints};
+  gc_arena_mark(arena, &savepoint->mark);
+
+  if (arena->savepoints) arena->savepoints->newer = savepoint;
+  arena->savepoints = savepoint;
+  return savepoint;
+}
+
+// Rewinds the Arena to a savepoint, invalidating any taken since. Returns
+// FALSE, leaving the Arena untouched, if the savepoint isn't valid for it.
+static mrb_bool gc_arena_savepoint_rewind(struct gc_arena *arena, struct gc_arena_savepoint *savepoint) {
+  if (savepoint->arena != arena) return FALSE;
+
+  gc_arena_savepoint_drop(arena, savepoint);
+  gc_arena_rewind(arena, &savepoint->mark);
+  return TRUE;
+}
+
+static void gc_arena_savepoint_free(mrb_state *mrb, void *ptr) {
+  struct gc_arena_savepoint *savepoint = ptr;
+  if (savepoint->arena) {
+    if (savepoint->newer) {
+      savepoint->newer->older = savepoint->older;
+    } else {
+      savepoint->arena->savepoints = savepoint->older;
+    }
+    if (savepoint->older) savepoint->older->newer = savepoint->newer;
+  }
+
+#ifdef GC_ARENA_TRACE
+  gc_arena_trace_lookup(savepoint, TRUE);
+#endif
+  free(savepoint);
+}
+
+// Adds capacity for `object_count` objects and `storage_bytes` of storage, with
+// at most one allocation for each, threading the object slots up front so that
+// mruby needn't add heap pages of its own. The capacity lasts until the next
+// reset.
+//
+// Objects and storage aren't carved from a single allocation: object pages are
+// kept apart so that slots stay densely packed, and each page is retained,
+// reused and freed on its own. Reserved-address Arenas commit storage in place.
+//
+// Returns FALSE, reserving nothing, if this would exceed the Arena's limits.
+//
+// @NOTE Reserved heap pages are appended to the end of both the heap list and
+//       the free list, so they're used in order after any current heap page.
+static mrb_bool gc_arena_reserve(struct gc_arena *arena, size_t object_count, size_t storage_bytes) {
+  size_t heaps = (object_count + GC_ARENA_HEAP_SLOTS - 1) / GC_ARENA_HEAP_SLOTS;
+  if (arena->max_objects && arena->counters.objects + GC_ARENA_HEAP_SLOTS * heaps > arena->max_objects) return FALSE;
+
+  if (storage_bytes > arena->page->end - arena->page->ptr && !add_page(arena, storage_bytes)) return FALSE;
+
+  struct gc_arena_page *page = arena->object_page;
+  if (heaps && (!page || page->end - page->ptr < GC_ARENA_CHUNK_BYTES * heaps)) gc_arena_add_object_page(arena, heaps);
+
+  mrb_heap_page *free_tail = arena->gc.free_heaps;
+  while (free_tail && free_tail->free_next) free_tail = free_tail->free_next;
+
+  while (heaps--) {
+    mrb_heap_page *heap = gc_arena_take_chunk(arena);
+    *heap = (mrb_heap_page){.prev = arena->heaps_tail, .free_prev = free_tail};
+    heap->freelist = gc_arena_initialize_heap(heap, GC_ARENA_HEAP_SLOTS);
+
+    arena->heaps_tail->next = heap;
+    arena->heaps_tail = heap;
+    if (free_tail) {
+      free_tail->free_next = heap;
+    } else {
+      arena->gc.free_heaps = heap;
+    }
+    free_tail = heap;
+    arena->counters.objects += GC_ARENA_HEAP_SLOTS;
+  }
+
+  return TRUE;
+}
+
+#ifdef GC_ARENA_PROFILE
+// Counts the live objects in each of the Arena's heap pages by type.
+static void gc_arena_census(struct gc_arena *arena, size_t counts[MRB_TT_MAXDEFINE]) {
+  memset(counts, 0, sizeof(size_t) * MRB_TT_MAXDEFINE);
+
+  for (mrb_heap_page *heap = arena->gc.heaps; heap; heap = heap->next) {
+    ObjectSlot *slot = (ObjectSlot *)heap->objects;
+    for (ObjectSlot *end = slot + gc_arena_heap_slots(arena, heap); slot < end; slot++) {
+      if (slot->as.ptr.tt != MRB_TT_FREE && slot->as.ptr.tt < MRB_TT_MAXDEFINE) counts[slot->as.ptr.tt]++;
+    }
+  }
+}
+#endif
+
+static struct gc_arena *gc_arena_descriptor(struct gc_arena_registry *registry) {
+  struct gc_arena *arena = registry->free_list;
+  if (arena) {
+    registry->free_list = arena->next_free;
+    return arena;
+  }
+
+  if (!registry->block_count || registry->block_used == block_capa(registry->block_count - 1)) {
+    registry->blocks[registry->block_count] = calloc(block_capa(registry->block_count), sizeof(struct gc_arena));
+    registry->block_count++;
+    registry->block_used = 0;
+  }
+
+  return &registry->blocks[registry->block_count - 1][registry->block_used++];
+}
+
+static inline size_t gc_arena_initial_size(size_t object_count, size_t storage_bytes) {
+  size_t gc_arena_size = 0;
+  gc_arena_size += sizeof(struct gc_arena_page);
+  gc_arena_size += sizeof(struct mrb_heap_page);
+  gc_arena_size += sizeof(ObjectSlot) * gc_arena_eager_objects(object_count);
+  gc_arena_size += GC_ARENA_CHUNK_BYTES * gc_arena_lazy_chunks(object_count);
+  gc_arena_size += storage_bytes;
+  return gc_arena_size;
+}
+
+static const struct gc_arena_growth gc_arena_default_growth = {
+  .mode = GC_ARENA_GROWTH_FIXED,
+  .factor = 2,
+  .page_size = GC_ARENA_PAGE_SIZE,
+  .max_page_size = GC_ARENA_MAX_PAGE_SIZE,
+  .next_page_size = GC_ARENA_PAGE_SIZE,
+};
+
+static const struct gc_arena_growth gc_arena_default_object_growth = {
+  .mode = GC_ARENA_GROWTH_FIXED,
+  .factor = 2,
+  .page_size = GC_ARENA_OBJECT_PAGE_SIZE,
+  .max_page_size = GC_ARENA_MAX_PAGE_SIZE,
+  .next_page_size = GC_ARENA_OBJECT_PAGE_SIZE,
+};
+
+// Sets up a new Arena in the given memory, which must be large enough to house
+// the first page, the heap page and `object_count` object slots. Reserved
+// memory may be committed on demand up to `limit`.
+//
+// @NOTE Only the first heap page's slots are threaded up front; the rest are
+//       left untouched until mruby asks for another heap page, so the cost of
+//       setup (and reset) is independent of the Arena's capacity.
+static struct gc_arena *gc_arena_setup(struct gc_arena_registry *registry, void *ptr, size_t gc_arena_size, void *limit, size_t object_count) {
+  // Portion out the allocated memory.
+  struct gc_arena_page *page = ptr;
+  void *end = ptr + gc_arena_size;
+  ptr = page + 1;
+
+  mrb_heap_page *heap = ptr;
+  ptr += sizeof(struct mrb_heap_page) + sizeof(ObjectSlot) * gc_arena_eager_objects(object_count);
+  void *frontier = ptr;
+  ptr += GC_ARENA_CHUNK_BYTES * gc_arena_lazy_chunks(object_count);
+
+  // Initialize our values.
+  struct gc_arena *arena = gc_arena_descriptor(registry);
+  *page = (struct gc_arena_page){
+    .start = heap + 1,
+    .ptr = ptr,
+    .end = end,
+    .floor = limit ? end : NULL,
+    .limit = limit,
+  };
+  *heap = (mrb_heap_page){.freelist = gc_arena_initialize_heap(heap, gc_arena_eager_objects(object_count))};
+  *arena = (struct gc_arena){
+    .registry = registry,
+    .gc = {
+      .heaps = heap,
+      .free_heaps = heap,
+      .current_white_part = GC_RED,
+      .disabled = TRUE,
+    },
+    .initial_objects = object_count,
+    .heap = heap,
+    .heaps_tail = heap,
+    .frontier = frontier,
+    .frontier_end = ptr,
+    .page = page,
+    .growth = gc_arena_default_growth,
+    .object_growth = gc_arena_default_object_growth,
+    .bump_below = GC_ARENA_HEAP_BYTES,
+    .counters = {
+      .pages = 1,
+      .objects = object_count,
+      .storage = page_capa(page),
+      .used = page->ptr - page->start,
+    },
+  };
+
+  gc_arena_index_insert(arena, page);
+  gc_arena_trace_created(arena);
+  return arena;
+}
+
+struct gc_arena *gc_arena_allocate(mrb_state *mrb, size_t object_count, size_t storage_bytes) {
+  // @NOTE We're allocating a single chunk of memory to house the arena and all
+  //       the anticipated data. This isn't strictly necessary — we could make
+  //       separate allocations — but it simplifies cleanup later.
+  size_t gc_arena_size = gc_arena_initial_size(object_count, storage_bytes);
+  return gc_arena_setup(gc_arena_registry_for(mrb), malloc(gc_arena_size), gc_arena_size, NULL, object_count);
+}
+
+// Allocates an Arena within a single reserved range of address space, which is
+// committed as the Arena grows. Returns NULL if the range cannot be reserved.
+struct gc_arena *gc_arena_allocate_vm(mrb_state *mrb, size_t object_count, size_t storage_bytes, size_t reserve_bytes, mrb_bool huge_pages) {
+  size_t gc_arena_size = round_up(gc_arena_initial_size(object_count, storage_bytes), GC_ARENA_VM_CHUNK);
+  if (reserve_bytes < gc_arena_size) reserve_bytes = gc_arena_size;
+  reserve_bytes = round_up(reserve_bytes, GC_ARENA_VM_CHUNK);
+
+  void *ptr = gc_arena_vm_reserve(reserve_bytes, huge_pages);
+  if (!ptr) return NULL;
+
+  if (!gc_arena_vm_commit(ptr, gc_arena_size)) {
+    gc_arena_vm_release(ptr, reserve_bytes);
+    return NULL;
+  }
+
+  return gc_arena_setup(gc_arena_registry_for(mrb), ptr, gc_arena_size, ptr + reserve_bytes, object_count);
+}
+
+static inline size_t gc_arena_image_hash(uint64_t key, size_t capa) {
+  return (key ^ key >> 3) * 0x9E3779B97F4A7C15ull & (capa - 1);
+}
+
+// Adds a key to the table, unless it is already present. Returns the index of
+// the new entry, or SIZE_MAX if the key was already known.
+static size_t gc_arena_image_names_add(struct gc_arena_image_names *names, uint64_t key) {
+  if ((names->count + 1) * 2 > names->slot_capa) {
+    free(names->slots);
+    names->slot_capa = names->slot_capa ? names->slot_capa * 2 : 64;
+    names->slots = calloc(names->slot_capa, sizeof(size_t));
+    names->entries = realloc(names->entries, sizeof(struct gc_arena_image_name) * names->slot_capa / 2);
+
+    for (size_t idx = 0; idx < names->count; idx++) {
+      size_t slot = gc_arena_image_hash(names->entries[idx].key, names->slot_capa);
+      while (names->slots[slot]) slot = (slot + 1) & (names->slot_capa - 1);
+      names->slots[slot] = idx + 1;
+    }
+  }
+
+  size_t slot = gc_arena_image_hash(key, names->slot_capa);
+  while (names->slots[slot]) {
+    if (names->entries[names->slots[slot] - 1].key == key) return SIZE_MAX;
+    slot = (slot + 1) & (names->slot_capa - 1);
+  }
+
+  names->slots[slot] = names->count + 1;
+  names->entries[names->count] = (struct gc_arena_image_name){.key = key};
+  return names->count++;
+}
+
+static void gc_arena_image_names_set(struct gc_arena_image_names *names, size_t idx, const char *name, size_t len) {
+  if (names->size + len > names->buffer_capa) {
+    while (names->size + len > names->buffer_capa) names->buffer_capa = names->buffer_capa ? names->buffer_capa * 2 : 1024;
+    names->buffer = realloc(names->buffer, names->buffer_capa);
+  }
+
+  memcpy(names->buffer + names->size, name, len);
+  names->entries[idx].offset = names->size;
+  names->entries[idx].len = len;
+  names->size += len;
+}
+
+static void gc_arena_image_names_free(struct gc_arena_image_names *names) {
+  free(names->entries);
+  free(names->slots);
+  free(names->buffer);
+  *names = (struct gc_arena_image_names){0};
+}
+
+static int gc_arena_image_compare_names(const void *a, const void *b) {
+  uint64_t x = ((const struct gc_arena_image_name *)a)->key;
+  uint64_t y = ((const struct gc_arena_image_name *)b)->key;
+  return x < y ? -1 : x > y;
+}
+
+static int gc_arena_image_compare_spans(const void *a, const void *b) {
+  uint64_t x = ((const struct gc_arena_image_span *)a)->address;
+  uint64_t y = ((const struct gc_arena_image_span *)b)->address;
+  return x < y ? -1 : x > y;
+}
+
+// Finds the entry for a key in a sorted name table, or SIZE_MAX.
+static inline size_t gc_arena_image_find(struct gc_arena_image_name *entries, size_t count, uint64_t key) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo < count && entries[lo].key == key ? lo : SIZE_MAX;
+}
+
+// Finds the span containing an address, in a list sorted by address. Addresses
+// just past the end of a span are considered to be within it.
+static inline struct gc_arena_image_span *gc_arena_image_span(struct gc_arena_image_span *spans, size_t count, uint64_t address) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (spans[mid].address <= address) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo == 0) return NULL;
+  struct gc_arena_image_span *span = &spans[lo - 1];
+  return address <= span->address + span->size ? span : NULL;
+}
+
+static inline void *gc_arena_image_relocate(struct gc_arena_image_span *spans, size_t count, uint64_t address) {
+  struct gc_arena_image_span *span = gc_arena_image_span(spans, count, address);
+  return span ? span->base + (address - span->address) : NULL;
+}
+
+// Whether an address within the Arena lies in an object slot (or heap page),
+// rather than in storage.
+static inline mrb_bool gc_arena_image_object_p(struct gc_arena *arena, void *ptr) {
+  if (ptr >= (void *)arena->heap && ptr < arena->frontier_end) return TRUE;
+  for (struct gc_arena_page *page = arena->object_page; page; page = page->next) {
+    if (ptr >= (void *)page && ptr < page->end) return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Flags a word for relocation on load, if it holds a pointer into the Arena.
+static void gc_arena_image_pointer(struct gc_arena_image_scan *scan, void *word) {
+  uint64_t value = *(uint64_t *)word;
+  if (!gc_arena_image_span(scan->spans, scan->count, value)) return;
+
+  struct gc_arena_image_span *span = gc_arena_image_span(scan->spans, scan->count, (uintptr_t)word);
+  if (!span) return;
+
+  size_t bit = (span->offset + ((uintptr_t)word - span->address)) / 8;
+  scan->bitmap[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+static inline void gc_arena_image_value(struct gc_arena_image_scan *scan, mrb_value *value) {
+  if (!mrb_immediate_p(*value)) gc_arena_image_pointer(scan, value);
+}
+
+// Flags the pointers among a run of words belonging to one of mruby's private
+// tables (a hash's entries and index, or instance variables), following them
+// into the blocks the table owns up to `depth` times.
+//
+// @NOTE These tables hold only sizes, symbols, values and pointers. Values are
+//       word-boxed, and no immediate value is an aligned address, so aligned
+//       words pointing into the Arena are taken to be pointers.
+static void gc_arena_image_table(struct gc_arena_image_scan *scan, uint64_t *words, uint64_t *end, int depth) {
+  for (uint64_t *word = words; word < end; word++) {
+    if (*word % sizeof(void *)) continue;
+
+    struct gc_arena_image_span *span = gc_arena_image_span(scan->spans, scan->count, *word);
+    if (!span) continue;
+
+    gc_arena_image_pointer(scan, word);
+    void *block = (void *)(uintptr_t)*word;
+    if (!depth || gc_arena_image_object_p(scan->arena, block) || *word == span->address + span->size) continue;
+
+    // Blocks are preceded by their size (or sized by their run), which can't
+    // extend past their page.
+    uint64_t size = gc_arena_block_size(span->base, block);
+    uint64_t room = span->address + span->size - *word;
+    gc_arena_image_table(scan, block, block + (size < room ? size : room) / 8 * 8, depth - 1);
+  }
+}
+
+// Flags every pointer held by the Arena's heap pages and objects, by walking
+// the fields of each type of object an image may contain. Other data (such as
+// string contents and numbers) is never mistaken for a pointer.
+//
+// @NOTE Strings and arrays are unshared before the Arena is dumped.
+static void gc_arena_image_objects(struct gc_arena_image_scan *scan) {
+  struct gc_arena *arena = scan->arena;
+  for (mrb_heap_page *heap = arena->gc.heaps; heap; heap = heap->next) {
+    gc_arena_image_pointer(scan, &heap->freelist);
+    gc_arena_image_pointer(scan, &heap->prev);
+    gc_arena_image_pointer(scan, &heap->next);
+    gc_arena_image_pointer(scan, &heap->free_next);
+    gc_arena_image_pointer(scan, &heap->free_prev);
+
+    ObjectSlot *slot = (ObjectSlot *)heap->objects;
+    for (ObjectSlot *end = slot + gc_arena_heap_slots(arena, heap); slot < end; slot++) {
+      struct RBasic *obj = (struct RBasic *)slot;
+      switch (obj->tt) {
+        case MRB_TT_FREE:
+          gc_arena_image_pointer(scan, &slot->as.ptr.p);
+          break;
+
+        case MRB_TT_STRING:
+          if (!RSTR_EMBED_P((struct RString *)obj)) gc_arena_image_pointer(scan, &((struct RString *)obj)->as.heap.ptr);
+          break;
+
+        case MRB_TT_ARRAY: {
+          mrb_value ary = mrb_obj_value(obj);
+          if (!ARY_EMBED_P(mrb_ary_ptr(ary))) gc_arena_image_pointer(scan, &mrb_ary_ptr(ary)->as.heap.ptr);
+          for (mrb_int idx = 0; idx < RARRAY_LEN(ary); idx++) gc_arena_image_value(scan, &RARRAY_PTR(ary)[idx]);
+          break;
+        }
+
+        case MRB_TT_RANGE: {
+          struct RRange *range = (struct RRange *)obj;
+#ifndef MRB_RANGE_EMBED
+          gc_arena_image_pointer(scan, &range->edges);
+          if (!range->edges) break;
+#endif
+          gc_arena_image_value(scan, &RANGE_BEG(range));
+          gc_arena_image_value(scan, &RANGE_END(range));
+          break;
+        }
+
+        case MRB_TT_OBJECT:
+          gc_arena_image_table(scan, (uint64_t *)(obj + 1), (uint64_t *)((struct RObject *)obj + 1), 2);
+          break;
+
+        case MRB_TT_HASH:
+          gc_arena_image_table(scan, (uint64_t *)(obj + 1), (uint64_t *)((struct RHash *)obj + 1), 2);
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+}
+
+// Writes the Arena's pages to an image, along with the given class and symbol
+// tables (which are sorted in the process) and a bitmap of every word pointing
+// into those pages.
+static mrb_bool gc_arena_image_dump(struct gc_arena *arena, const char *path, void *root, struct gc_arena_image_names *classes, struct gc_arena_image_names *symbols, uint32_t flags) {
+  // Object pages are stored ahead of the run and storage pages, so that the
+  // first page remains last.
+  struct gc_arena_page *lists[3] = {arena->object_page, arena->run_page, arena->page};
+  size_t counts[3] = {0, 0, 0};
+  for (int list = 0; list < 3; list++) {
+    for (struct gc_arena_page *page = lists[list]; page; page = page->next) counts[list]++;
+  }
+  size_t count = counts[0] + counts[1] + counts[2];
+
+  struct gc_arena_image_page *pages = malloc(sizeof(struct gc_arena_image_page) * count);
+  struct gc_arena_image_span *spans = malloc(sizeof(struct gc_arena_image_span) * count);
+  size_t data_size = 0;
+  size_t idx = 0;
+  for (int list = 0; list < 3; list++) {
+    for (struct gc_arena_page *page = lists[list]; page; page = page->next, idx++) {
+      size_t size = page->ptr - (void *)page;
+      pages[idx] = (struct gc_arena_image_page){.address = (uintptr_t)page, .size = size, .offset = data_size};
+      spans[idx] = (struct gc_arena_image_span){.address = (uintptr_t)page, .size = size, .base = page, .offset = data_size};
+      data_size += round_up(size, 64);
+    }
+  }
+
+  qsort(spans, count, sizeof(struct gc_arena_image_span), gc_arena_image_compare_spans);
+  if (classes->count) qsort(classes->entries, classes->count, sizeof(struct gc_arena_image_name), gc_arena_image_compare_names);
+  if (symbols->count) qsort(symbols->entries, symbols->count, sizeof(struct gc_arena_image_name), gc_arena_image_compare_names);
+
+  // Symbol names are stored after the class names.
+  for (idx = 0; idx < symbols->count; idx++) symbols->entries[idx].offset += classes->size;
+
+  size_t tables = sizeof(struct gc_arena_image_header);
+  tables += sizeof(struct gc_arena_image_page) * count;
+  tables += sizeof(struct gc_arena_image_name) * (classes->count + symbols->count);
+  tables += classes->size + symbols->size;
+
+  struct gc_arena_image_header header = {
+    .magic = GC_ARENA_IMAGE_MAGIC,
+    .version = GC_ARENA_IMAGE_VERSION,
+    .slot_size = sizeof(ObjectSlot),
+    .value_size = sizeof(mrb_value),
+    .flags = flags,
+    .page_count = count,
+    .class_count = classes->count,
+    .symbol_count = symbols->count,
+    .names_size = classes->size + symbols->size,
+    .data_offset = round_up(tables, GC_ARENA_IMAGE_ALIGN),
+    .data_size = data_size,
+    .heaps = (uintptr_t)arena->gc.heaps,
+    .free_heaps = (uintptr_t)arena->gc.free_heaps,
+    .heap = (uintptr_t)arena->heap,
+    .frontier = (uintptr_t)arena->frontier,
+    .frontier_end = (uintptr_t)arena->frontier_end,
+    .root = (uintptr_t)root,
+    .live = arena->gc.live,
+    .initial_objects = arena->initial_objects,
+    .objects = arena->counters.objects,
+    .headers = arena->counters.headers,
+    .padding = arena->counters.padding,
+    .abandoned = arena->counters.abandoned,
+    .freed = arena->counters.freed,
+    .object_pages = counts[0],
+  };
+
+  // Page headers are rebuilt on load, and are not scanned.
+  size_t bitmap_words = (data_size / 8 + 63) / 64;
+  uint64_t *bitmap = calloc(bitmap_words, sizeof(uint64_t));
+  struct gc_arena_image_scan scan = {.arena = arena, .spans = spans, .count = count, .bitmap = bitmap};
+  gc_arena_image_objects(&scan);
+
+  FILE *file = fopen(path, "wb");
+  mrb_bool ok = file != NULL;
+  if (ok) {
+    static const char padding[GC_ARENA_IMAGE_ALIGN] = {0};
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(pages, sizeof(struct gc_arena_image_page), count, file);
+    if (classes->count) fwrite(classes->entries, sizeof(struct gc_arena_image_name), classes->count, file);
+    if (symbols->count) fwrite(symbols->entries, sizeof(struct gc_arena_image_name), symbols->count, file);
+    if (classes->size) fwrite(classes->buffer, 1, classes->size, file);
+    if (symbols->size) fwrite(symbols->buffer, 1, symbols->size, file);
+    fwrite(padding, 1, header.data_offset - tables, file);
+
+    for (idx = 0; idx < count; idx++) {
+      fwrite((void *)(uintptr_t)pages[idx].address, 1, pages[idx].size, file);
+      fwrite(padding, 1, round_up(pages[idx].size, 64) - pages[idx].size, file);
+    }
+
+    fwrite(bitmap, sizeof(uint64_t), bitmap_words, file);
+    ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+  }
+
+  free(bitmap);
+  free(spans);
+  free(pages);
+  return ok;
+}
+
+static void gc_arena_image_close(struct gc_arena_image *image) {
+  gc_arena_image_unmap(image->map, image->size);
+  *image = (struct gc_arena_image){0};
+}
+
+static inline mrb_bool gc_arena_image_valid_names(struct gc_arena_image_name *entries, size_t count, size_t names_size) {
+  for (size_t idx = 0; idx < count; idx++) {
+    if (entries[idx].offset > names_size || entries[idx].len > names_size - entries[idx].offset) return FALSE;
+  }
+
+  return TRUE;
+}
+
+// Maps an image file into memory, checking that it was written by this build
+// and that its tables lie within the file.
+static mrb_bool gc_arena_image_open(const char *path, struct gc_arena_image *image) {
+  size_t size = 0;
+  void *map = gc_arena_image_map(path, &size);
+  if (!map) return FALSE;
+
+  struct gc_arena_image_header *header = map;
+  *image = (struct gc_arena_image){.map = map, .size = size, .header = header};
+
+  mrb_bool valid = size >= sizeof(struct gc_arena_image_header);
+  valid = valid && !memcmp(header->magic, GC_ARENA_IMAGE_MAGIC, 4) && header->version == GC_ARENA_IMAGE_VERSION;
+  valid = valid && header->slot_size == sizeof(ObjectSlot) && header->value_size == sizeof(mrb_value);
+  valid = valid && header->page_count && header->page_count < size && header->class_count < size && header->symbol_count < size;
+  valid = valid && header->names_size < size && header->data_offset <= size && header->data_size <= size - header->data_offset;
+
+  size_t tables = sizeof(struct gc_arena_image_header);
+  if (valid) {
+    tables += sizeof(struct gc_arena_image_page) * header->page_count;
+    tables += sizeof(struct gc_arena_image_name) * (header->class_count + header->symbol_count);
+    tables += header->names_size;
+    valid = tables <= header->data_offset;
+    valid = valid && (header->data_size / 8 + 63) / 64 * 8 <= size - header->data_offset - header->data_size;
+  }
+
+  if (valid) {
+    image->pages = (void *)(header + 1);
+    image->classes = (void *)(image->pages + header->page_count);
+    image->symbols = image->classes + header->class_count;
+    image->names = (void *)(image->symbols + header->symbol_count);
+    image->data = map + header->data_offset;
+    image->bitmap = image->data + header->data_size;
+
+    for (size_t idx = 0; valid && idx < header->page_count; idx++) {
+      struct gc_arena_image_page *page = &image->pages[idx];
+      valid = page->size >= sizeof(struct gc_arena_page) && page->size % 8 == 0 && page->offset % 64 == 0;
+      valid = valid && page->offset <= header->data_size && page->size <= header->data_size - page->offset;
+
+      // Run pages must hold blocks of one of the small size classes.
+      size_t run_size = valid ? ((struct gc_arena_page *)(image->data + page->offset))->run_size : 0;
+      valid = valid && run_size % 8 == 0 && run_size <= GC_ARENA_SMALL_CLASSES * 8;
+    }
+
+    // The first heap page immediately follows the first page's header.
+    struct gc_arena_image_page *first = &image->pages[header->page_count - 1];
+    valid = valid && header->object_pages < header->page_count;
+    valid = valid && header->heap == first->address + sizeof(struct gc_arena_page);
+    valid = valid && first->size >= sizeof(struct gc_arena_page) + sizeof(mrb_heap_page);
+    valid = valid && gc_arena_image_valid_names(image->classes, header->class_count, header->names_size);
+    valid = valid && gc_arena_image_valid_names(image->symbols, header->symbol_count, header->names_size);
+  }
+
+  if (!valid) gc_arena_image_close(image);
+  return valid;
+}
+
+// Rebuilds an Arena within a mapped image, relocating every marked pointer and
+// replacing each object's class with the corresponding entry of `classes`. The
+// Arena takes ownership of the mapping.
+static struct gc_arena *gc_arena_image_restore(mrb_state *mrb, struct gc_arena_image *image, struct RClass **classes, void **root) {
+  struct gc_arena_image_header *header = image->header;
+  size_t count = header->page_count;
+
+  struct gc_arena_image_span *spans = malloc(sizeof(struct gc_arena_image_span) * count);
+  for (size_t idx = 0; idx < count; idx++) {
+    struct gc_arena_image_page *page = &image->pages[idx];
+    spans[idx] = (struct gc_arena_image_span){.address = page->address, .size = page->size, .base = image->data + page->offset};
+  }
+  qsort(spans, count, sizeof(struct gc_arena_image_span), gc_arena_image_compare_spans);
+
+  // Pointers tend to refer to nearby data, so the last span found is checked
+  // before searching.
+  uint64_t *words = image->data;
+  uint64_t *words_end = words + header->data_size / 8;
+  struct gc_arena_image_span *span = spans;
+  for (size_t idx = 0; idx < (header->data_size / 8 + 63) / 64; idx++) {
+    for (uint64_t bits = image->bitmap[idx]; bits; bits &= bits - 1) {
+      uint64_t *word = words + idx * 64 + __builtin_ctzll(bits);
+      if (word >= words_end) break;
+
+      if (*word < span->address || *word > span->address + span->size) {
+        struct gc_arena_image_span *found = gc_arena_image_span(spans, count, *word);
+        if (!found) continue;
+        span = found;
+      }
+
+      *word = (uintptr_t)span->base + (*word - span->address);
+    }
+  }
+
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  struct gc_arena *arena = gc_arena_descriptor(registry);
+  *arena = (struct gc_arena){
+    .registry = registry,
+    .gc = {
+      .heaps = gc_arena_image_relocate(spans, count, header->heaps),
+      .free_heaps = gc_arena_image_relocate(spans, count, header->free_heaps),
+      .live = header->live,
+      .current_white_part = GC_RED,
+      .disabled = TRUE,
+    },
+    .initial_objects = header->initial_objects,
+    .heap = gc_arena_image_relocate(spans, count, header->heap),
+    .frontier = gc_arena_image_relocate(spans, count, header->frontier),
+    .frontier_end = gc_arena_image_relocate(spans, count, header->frontier_end),
+    .growth = gc_arena_default_growth,
+    .object_growth = gc_arena_default_object_growth,
+    .bump_below = GC_ARENA_HEAP_BYTES,
+    .counters = {
+      .objects = header->objects,
+      .headers = header->headers,
+      .padding = header->padding,
+      .abandoned = header->abandoned,
+      .freed = header->freed,
+    },
+    .image = image->map,
+    .image_size = image->size,
+  };
+  *root = gc_arena_image_relocate(spans, count, header->root);
+
+  // Loaded pages are full; the first page's range begins after its heap page.
+  // Object pages are listed ahead of the storage pages, and run pages keep the
+  // size of their blocks.
+  for (size_t idx = count; idx-- > 0;) {
+    struct gc_arena_page *page = image->data + image->pages[idx].offset;
+    void *end = (void *)page + image->pages[idx].size;
+    mrb_bool objects = idx < header->object_pages;
+    size_t run_size = objects || idx == count - 1 ? 0 : page->run_size;
+    *page = (struct gc_arena_page){
+      .next = objects ? arena->object_page : run_size ? arena->run_page : arena->page,
+      .start = idx == count - 1 ? (void *)(arena->heap + 1) : (void *)(page + 1),
+      .ptr = end,
+      .end = end,
+      .shared = TRUE,
+      .run_size = run_size,
+    };
+
+    if (objects) {
+      arena->object_page = page;
+      arena->counters.object_pages += 1;
+      arena->counters.object_storage += page_capa(page);
+    } else {
+      if (run_size) {
+        arena->run_page = page;
+      } else {
+        arena->page = page;
+      }
+      arena->counters.pages += 1;
+      arena->counters.storage += page_capa(page);
+      arena->counters.used += page_capa(page);
+      if (idx != count - 1) arena->counters.overflow += page_capa(page);
+    }
+    gc_arena_index_insert(arena, page);
+  }
+
+  for (mrb_heap_page *heap = arena->gc.heaps; heap; heap = heap->next) {
+    arena->heaps_tail = heap;
+    ObjectSlot *slot = (ObjectSlot *)heap->objects;
+    for (ObjectSlot *end = slot + gc_arena_heap_slots(arena, heap); slot < end; slot++) {
+      struct RBasic *obj = (struct RBasic *)slot;
+      if (obj->tt == MRB_TT_FREE) continue;
+
+      size_t idx = gc_arena_image_find(image->classes, header->class_count, (uintptr_t)obj->c);
+      if (idx != SIZE_MAX) obj->c = classes[idx];
+      obj->gcnext = NULL;
+    }
+  }
+
+  free(spans);
+  gc_arena_trace_created(arena);
+  return arena;
+}
+
+// Switches the state's allocation context to `ud` (an Arena, or the registry
+// for the GC heap), parking the current context's GC with its owner. The GC
+// arena of protected objects belongs to the state, and is carried across.
+static inline void gc_arena_switch(mrb_state *mrb, void *ud) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  if (ud == mrb->allocf_ud) return;
+
+  mrb_gc *from = mrb->allocf_ud == registry ? &registry->gc : &((struct gc_arena *)mrb->allocf_ud)->gc;
+  mrb_gc *to = ud == registry ? &registry->gc : &((struct gc_arena *)ud)->gc;
+
+  // Arenas never collect, so one Arena's GC differs from the next only in its
+  // heap pages and live count.
+  if (from != &registry->gc && to != &registry->gc) {
+    from->heaps = mrb->gc.heaps;
+    from->sweeps = mrb->gc.sweeps;
+    from->free_heaps = mrb->gc.free_heaps;
+    from->live = mrb->gc.live;
+    mrb->gc.heaps = to->heaps;
+    mrb->gc.sweeps = to->sweeps;
+    mrb->gc.free_heaps = to->free_heaps;
+    mrb->gc.live = to->live;
+    mrb->allocf_ud = ud;
+    return;
+  }
+
+  struct RBasic **protected = mrb->gc.arena;
+  int arena_idx = mrb->gc.arena_idx;
+  int arena_capa = mrb->gc.arena_capa;
+
+  *from = mrb->gc;
+  mrb->gc = *to;
+  mrb->gc.arena = protected;
+  mrb->gc.arena_idx = arena_idx;
+  mrb->gc.arena_capa = arena_capa;
+  mrb->allocf_ud = ud;
+}
+
+// Pushes an eval, swapping in the Arena's GC and allocator. Re-entering the
+// current context leaves its parent unchanged.
+static inline void gc_arena_eval_push(mrb_state *mrb, struct gc_arena_eval_cb_data *data) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  void *ud = data->arena ? (void *)data->arena : registry;
+
+  data->original_allocf_ud = mrb->allocf_ud;
+  data->original_arena_idx = mrb->gc.arena_idx;
+  data->original_entered = registry->entered_count;
+  if (!data->parent) data->parent = ud == mrb->allocf_ud && registry->evals ? registry->evals->parent : mrb->allocf_ud;
+  data->prev = registry->evals;
+  registry->evals = data;
+
+  gc_arena_switch(mrb, ud);
+  if (data->arena) TRACE(GC_ARENA_TRACE_EVAL, data->arena, 0, 0);
+}
+
+// Fills one of the registry's root slots. The slots live in the GC heap, so
+// the write (and its barrier) happens there, wherever the state currently is.
+static void gc_arena_root_set(mrb_state *mrb, struct gc_arena_registry *registry, size_t idx, mrb_value value) {
+  void *ud = mrb->allocf_ud;
+  if (ud != registry) gc_arena_switch(mrb, registry);
+  MRB(mrb_ary_set)(mrb, registry->roots, idx, value);
+  if (ud != registry) gc_arena_switch(mrb, ud);
+}
+
+// Pops an eval (along with any entered Arenas left above it), restoring the
+// context it was nested in. Objects protected during the eval may belong to
+// the Arena, and are released, as are the owners of the entered Arenas.
+static inline void gc_arena_eval_pop(mrb_state *mrb, struct gc_arena_eval_cb_data *data) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  if (data->arena) TRACE(GC_ARENA_TRACE_LEAVE, data->arena, 0, 0);
+
+  gc_arena_switch(mrb, data->original_allocf_ud);
+  mrb->gc.arena_idx = data->original_arena_idx;
+  registry->evals = data->prev;
+  while (registry->entered_count > data->original_entered) {
+    mrb_value owner = registry->entered[--registry->entered_count].owner;
+    if (!mrb_nil_p(owner)) gc_arena_root_set(mrb, registry, registry->entered_count, mrb_nil_value());
+  }
+}
+
+mrb_value gc_arena_eval_body(struct mrb_state *mrb, mrb_value data_cptr) {
+  struct gc_arena_eval_cb_data *data = mrb_cptr(data_cptr);
+  gc_arena_eval_push(mrb, data);
+
+  // Evaluate the block (or function).
+  if (data->func) return data->func(mrb, data->func_data);
+  return MRB(mrb_yield_argv)(mrb, data->block, 0, NULL);
+}
+
+mrb_value gc_arena_eval_ensure(struct mrb_state *mrb, mrb_value data_cptr) {
+  gc_arena_eval_pop(mrb, mrb_cptr(data_cptr));
+  return mrb_nil_value();
+}
+
+static mrb_value gc_arena_overflow_body(mrb_state *mrb, mrb_value data_cptr) {
+  struct gc_arena_overflow_call *call = mrb_cptr(data_cptr);
+  mrb_sym kinds[2] = {MRB(mrb_intern_static)(mrb, "objects", 7), MRB(mrb_intern_static)(mrb, "storage", 7)};
+  size_t sizes[2] = {call->objects, call->storage};
+
+  for (int idx = 0; idx < 2; idx++) {
+    if (!sizes[idx]) continue;
+    mrb_value args[2] = {mrb_symbol_value(kinds[idx]), mrb_fixnum_value(sizes[idx])};
+    MRB(mrb_funcall_argv)(mrb, call->arena->overflow_hook, MRB(mrb_intern_static)(mrb, "call", 4), 2, args);
+  }
+
+  return mrb_nil_value();
+}
+
+static mrb_value gc_arena_overflow_ensure(mrb_state *mrb, mrb_value data_cptr) {
+  struct gc_arena_overflow_call *call = mrb_cptr(data_cptr);
+  call->arena->overflowing = FALSE;
+  return mrb_nil_value();
+}
+
+// Reports the bytes of objects and storage that fell back since the last
+// report to the Arena's overflow hook, which may raise. Hooks run only outside
+// the allocator and once the state has left the Arena, so they allocate in the
+// enclosing context; a hook is never re-entered by its own evals.
+static void gc_arena_overflow_notify(mrb_state *mrb, struct gc_arena *arena) {
+  if (arena->on_overflow != GC_ARENA_OVERFLOW_HOOK || arena->overflowing || mrb->allocf_ud == arena) return;
+  if (!arena->overflow_pending_objects && !arena->overflow_pending_storage) return;
+
+  struct gc_arena_overflow_call call = {
+    .arena = arena,
+    .objects = arena->overflow_pending_objects,
+    .storage = arena->overflow_pending_storage,
+  };
+  mrb_value data_cptr = mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = &call});
+  arena->overflow_pending_objects = 0;
+  arena->overflow_pending_storage = 0;
+  arena->overflowing = TRUE;
+
+  MRB(mrb_ensure)(mrb, gc_arena_overflow_body, data_cptr, gc_arena_overflow_ensure, data_cptr);
+}
+
+// Enters the Arena until the matching `gc_arena_leave`, as `eval` would for a
+// block, keeping `owner` (unless nil) alive until then. Returns FALSE if too
+// many Arenas have been entered.
+static mrb_bool gc_arena_enter(mrb_state *mrb, struct gc_arena *arena, mrb_value owner) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  if (registry->entered_count == GC_ARENA_MAX_ENTERED) return FALSE;
+
+  if (!mrb_nil_p(owner)) gc_arena_root_set(mrb, registry, registry->entered_count, owner);
+  struct gc_arena_eval_cb_data *data = &registry->entered[registry->entered_count];
+  *data = (struct gc_arena_eval_cb_data){.arena = arena, .owner = owner};
+  gc_arena_eval_push(mrb, data);
+  registry->entered_count++;
+  return TRUE;
+}
+
+// Leaves the most recently entered Arena, which must be the innermost eval.
+static mrb_bool gc_arena_leave(mrb_state *mrb, struct gc_arena *arena) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  struct gc_arena_eval_cb_data *data = registry->evals;
+  if (!registry->entered_count || data != &registry->entered[registry->entered_count - 1] || data->arena != arena) return FALSE;
+
+  gc_arena_eval_pop(mrb, data);
+  return TRUE;
+}
+
+// Yields each item within the Arena, collecting the results in the caller's
+// context; only the state's allocator and GC are switched between items.
+static mrb_value gc_arena_each_items(mrb_state *mrb, void *data) {
+  struct gc_arena_each *each = data;
+  for (mrb_int idx = 0; idx < RARRAY_LEN(each->items); idx++) {
+    mrb_value result = MRB(mrb_yield)(mrb, each->block, MRB(mrb_ary_entry)(each->items, idx));
+    gc_arena_switch(mrb, each->caller);
+    MRB(mrb_ary_push)(mrb, each->results, result);
+    gc_arena_switch(mrb, each->arena);
+  }
+
+  return each->results;
+}
+
+// Creates a collection with its backing storage allocated once, at exactly the
+// requested capacity, and fills an Array with any given items (or the block's
+// results for them).
+static mrb_value gc_arena_new_collection(mrb_state *mrb, void *data) {
+  struct gc_arena_collection *collection = data;
+  switch (collection->type) {
+    case GC_ARENA_COLLECTION_HASH:
+      return MRB(mrb_hash_new_capa)(mrb, collection->capacity);
+    case GC_ARENA_COLLECTION_STRING:
+      return MRB(mrb_str_new_capa)(mrb, collection->capacity);
+    case GC_ARENA_COLLECTION_ARRAY:
+      break;
+  }
+
+  mrb_value array = MRB(mrb_ary_new_capa)(mrb, collection->capacity);
+  if (mrb_nil_p(collection->items)) return array;
+
+  for (mrb_int idx = 0; idx < RARRAY_LEN(collection->items); idx++) {
+    mrb_value item = MRB(mrb_ary_entry)(collection->items, idx);
+    if (!mrb_nil_p(collection->block)) item = MRB(mrb_yield)(mrb, collection->block, item);
+    MRB(mrb_ary_push)(mrb, array, item);
+  }
+
+  return array;
+}
+
+// Copies a String into the Arena, frozen, so that it can be interned.
+static mrb_value gc_arena_intern_copy(mrb_state *mrb, void *data) {
+  mrb_value *str = data;
+  return MRB(mrb_obj_freeze)(mrb, MRB(mrb_str_new)(mrb, RSTRING_PTR(*str), RSTRING_LEN(*str)));
+}
+
+static mrb_value gc_arena_eval(mrb_state *mrb, struct gc_arena *arena, mrb_value block) {
+  struct gc_arena_eval_cb_data data = {.arena = arena, .block = block};
+  mrb_value data_cptr = mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = &data});
+
+  mrb_value result = MRB(mrb_ensure)(mrb, gc_arena_eval_body, data_cptr, gc_arena_eval_ensure, data_cptr);
+  if (arena) gc_arena_overflow_notify(mrb, arena);
+  return result;
+}
+
+// Calls a C function within the Arena, as `eval` does with a block.
+static mrb_value gc_arena_eval_func(mrb_state *mrb, struct gc_arena *arena, mrb_value (*func)(mrb_state *, void *), void *func_data) {
+  struct gc_arena_eval_cb_data data = {.arena = arena, .func = func, .func_data = func_data};
+  mrb_value data_cptr = mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = &data});
+
+  mrb_value result = MRB(mrb_ensure)(mrb, gc_arena_eval_body, data_cptr, gc_arena_eval_ensure, data_cptr);
+  if (arena) gc_arena_overflow_notify(mrb, arena);
+  return result;
+}
+
+// Evaluates the block in the context enclosing the innermost eval: the Arena
+// it was nested in, or the GC heap.
+static mrb_value gc_arena_outer(mrb_state *mrb, mrb_value block) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  struct gc_arena_eval_cb_data *top = registry->evals;
+  if (!top) return MRB(mrb_yield_argv)(mrb, block, 0, NULL);
+
+  // The enclosing context's own parent is found where it was entered.
+  struct gc_arena_eval_cb_data data = {.arena = top->parent == registry ? NULL : top->parent, .block = block, .parent = registry};
+  for (struct gc_arena_eval_cb_data *eval = top; data.arena && eval; eval = eval->prev) {
+    if (eval->arena != data.arena) continue;
+    data.parent = eval->parent;
+    break;
+  }
+
+  mrb_value data_cptr = mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = &data});
+  return MRB(mrb_ensure)(mrb, gc_arena_eval_body, data_cptr, gc_arena_eval_ensure, data_cptr);
+}
+
+// Allocates a data object in the GC heap, even within an Arena, so that the
+// objects owning Arenas (and Rings) are only ever released by the GC.
+static struct RData *gc_arena_data_object_alloc(mrb_state *mrb, struct RClass *cls, void *ptr, const mrb_data_type *type) {
+  struct gc_arena_registry *registry = gc_arena_registry_for(mrb);
+  void *ud = mrb->allocf_ud;
+  if (ud != registry) gc_arena_switch(mrb, registry);
+
+  struct RData *obj = MRB(mrb_data_object_alloc)(mrb, cls, ptr, type);
+  if (ud != registry) gc_arena_switch(mrb, ud);
+  return obj;
+}
+
+static void gc_arena_dump_symbol(mrb_state *mrb, struct gc_arena_dump *dump, mrb_sym sym) {
+  size_t idx = gc_arena_image_names_add(&dump->symbols, sym);
+  if (idx == SIZE_MAX) return;
+
+  mrb_int len = 0;
+  const char *name = MRB(mrb_sym_name_len)(mrb, sym, &len);
+  gc_arena_image_names_set(&dump->symbols, idx, name ? name : "", len);
+}
+
+// Records the symbols and classes a value refers to, and rejects references to
+// anything that won't be part of the image.
+static void gc_arena_dump_value(mrb_state *mrb, struct gc_arena_dump *dump, mrb_value value) {
+  if (mrb_symbol_p(value)) {
+    gc_arena_dump_symbol(mrb, dump, mrb_symbol(value));
+  } else if (mrb_type(value) == MRB_TT_CPTR) {
+    dump->error = "Arena images cannot contain C pointers.";
+  } else if (mrb_immediate_p(value)) {
+    return;
+  } else if (mrb_type(value) == MRB_TT_CLASS || mrb_type(value) == MRB_TT_MODULE) {
+    gc_arena_image_names_add(&dump->classes, (uintptr_t)mrb_ptr(value));
+    dump->flags |= GC_ARENA_IMAGE_FIXUP_VALUES;
+  } else if (!is_in_arena(dump->arena, mrb_ptr(value))) {
+    dump->error = "Arena images cannot refer to objects outside the Arena.";
+  }
+}
+
+static int gc_arena_dump_pair(mrb_state *mrb, mrb_value key, mrb_value value, void *data) {
+  struct gc_arena_dump *dump = data;
+
+  // Objects other than strings are hashed by address.
+  if (!mrb_immediate_p(key) && !mrb_string_p(key)) dump->flags |= GC_ARENA_IMAGE_FIXUP_VALUES;
+  gc_arena_dump_value(mrb, dump, key);
+  gc_arena_dump_value(mrb, dump, value);
+  return 0;
+}
+
+static int gc_arena_dump_ivar(mrb_state *mrb, mrb_sym sym, mrb_value value, void *data) {
+  gc_arena_dump_symbol(mrb, data, sym);
+  gc_arena_dump_value(mrb, data, value);
+  return 0;
+}
+
+// Visits every object in the active Arena, collecting the classes and symbols
+// they refer to. Strings and arrays sharing their contents (with each other, or
+// with objects outside the Arena) are given a copy of their own.
+static mrb_value gc_arena_dump_objects(mrb_state *mrb, void *data) {
+  struct gc_arena_dump *dump = data;
+
+  for (mrb_heap_page *heap = mrb->gc.heaps; heap && !dump->error; heap = heap->next) {
+    ObjectSlot *slot = (ObjectSlot *)heap->objects;
+    for (ObjectSlot *end = slot + gc_arena_heap_slots(dump->arena, heap); slot < end && !dump->error; slot++) {
+      struct RBasic *obj = (struct RBasic *)slot;
+      if (obj->tt == MRB_TT_FREE) continue;
+
+      mrb_value value = mrb_obj_value(obj);
+      mrb_bool frozen = MRB_FROZEN_P(obj);
+      switch (obj->tt) {
+        case MRB_TT_STRING:
+          if (!RSTR_SHARED_P(mrb_str_ptr(value)) && !RSTR_FSHARED_P(mrb_str_ptr(value)) && is_in_arena(dump->arena, RSTRING_PTR(value))) break;
+          MRB_UNSET_FROZEN_FLAG(obj);
+          MRB(mrb_str_modify)(mrb, mrb_str_ptr(value));
+          if (frozen) MRB_SET_FROZEN_FLAG(obj);
+          break;
+
+        case MRB_TT_ARRAY:
+          if (ARY_SHARED_P(mrb_ary_ptr(value)) || (RARRAY_LEN(value) && !is_in_arena(dump->arena, RARRAY_PTR(value)))) {
+            MRB_UNSET_FROZEN_FLAG(obj);
+            MRB(mrb_ary_modify)(mrb, mrb_ary_ptr(value));
+            if (frozen) MRB_SET_FROZEN_FLAG(obj);
+          }
+          for (mrb_int idx = 0; idx < RARRAY_LEN(value); idx++) gc_arena_dump_value(mrb, dump, RARRAY_PTR(value)[idx]);
+          break;
+
+        case MRB_TT_HASH:
+          MRB(mrb_hash_foreach)(mrb, mrb_hash_ptr(value), gc_arena_dump_pair, dump);
+          break;
+
+        case MRB_TT_OBJECT:
+        case MRB_TT_RANGE:
+        case MRB_TT_FLOAT:
+          break;
+
+        default:
+          dump->error = "Arena images can only contain plain objects, strings, arrays, hashes, ranges, integers and floats.";
+          continue;
+      }
+
+      gc_arena_image_names_add(&dump->classes, (uintptr_t)obj->c);
+      MRB(mrb_iv_foreach)(mrb, value, gc_arena_dump_ivar, dump);
+    }
+  }
+
+  return mrb_nil_value();
+}
+
+static inline mrb_sym gc_arena_load_symbol(struct gc_arena_load *load, mrb_sym sym) {
+  size_t idx = gc_arena_image_find(load->image->symbols, load->image->header->symbol_count, sym);
+  return idx == SIZE_MAX ? sym : load->symbols[idx];
+}
+
+// Resolves a value's symbol or class, if any, flagging whether it has changed.
+static inline mrb_value gc_arena_load_value(struct gc_arena_load *load, mrb_value value, mrb_bool *changed) {
+  if (mrb_symbol_p(value)) {
+    mrb_sym sym = gc_arena_load_symbol(load, mrb_symbol(value));
+    if (sym == mrb_symbol(value)) return value;
+
+    *changed = TRUE;
+    return mrb_symbol_value(sym);
+  }
+
+  if (mrb_type(value) != MRB_TT_CLASS && mrb_type(value) != MRB_TT_MODULE) return value;
+
+  size_t idx = gc_arena_image_find(load->image->classes, load->image->header->class_count, (uintptr_t)mrb_ptr(value));
+  if (idx == SIZE_MAX) return value;
+
+  *changed = TRUE;
+  return mrb_obj_value(load->classes[idx]);
+}
+
+static int gc_arena_load_pair(mrb_state *mrb, mrb_value key, mrb_value value, void *data) {
+  struct gc_arena_load *load = data;
+  if (load->count == load->capa) {
+    load->capa = load->capa ? load->capa * 2 : 64;
+    load->pairs = realloc(load->pairs, sizeof(struct gc_arena_load_pair) * load->capa);
+  }
+
+  load->pairs[load->count++] = (struct gc_arena_load_pair){.key = key, .value = value};
+  return 0;
+}
+
+static int gc_arena_load_ivar(mrb_state *mrb, mrb_sym sym, mrb_value value, void *data) {
+  return gc_arena_load_pair(mrb, mrb_symbol_value(sym), value, data);
+}
+
+// Visits every object in the active Arena, re-resolving the symbols and classes
+// they refer to. Hashes whose keys have changed (or are hashed by address) are
+// rebuilt, as are instance variable tables whose names have changed.
+static mrb_value gc_arena_load_objects(mrb_state *mrb, void *data) {
+  struct gc_arena_load *load = data;
+  struct gc_arena *arena = mrb->allocf_ud;
+
+  for (mrb_heap_page *heap = mrb->gc.heaps; heap; heap = heap->next) {
+    ObjectSlot *slot = (ObjectSlot *)heap->objects;
+    for (ObjectSlot *end = slot + gc_arena_heap_slots(arena, heap); slot < end; slot++) {
+      struct RBasic *obj = (struct RBasic *)slot;
+      if (obj->tt == MRB_TT_FREE) continue;
+
+      mrb_value value = mrb_obj_value(obj);
+      mrb_bool frozen = MRB_FROZEN_P(obj);
+      mrb_bool changed = FALSE;
+      MRB_UNSET_FROZEN_FLAG(obj);
+
+      if (obj->tt == MRB_TT_ARRAY) {
+        mrb_value *values = RARRAY_PTR(value);
+        for (mrb_int idx = 0; idx < RARRAY_LEN(value); idx++) values[idx] = gc_arena_load_value(load, values[idx], &changed);
+      } else if (obj->tt == MRB_TT_HASH) {
+        load->count = 0;
+        MRB(mrb_hash_foreach)(mrb, mrb_hash_ptr(value), gc_arena_load_pair, load);
+
+        mrb_bool rehash = FALSE;
+        for (size_t idx = 0; idx < load->count; idx++) {
+          struct gc_arena_load_pair *pair = &load->pairs[idx];
+          pair->key = gc_arena_load_value(load, pair->key, &rehash);
+          pair->value = gc_arena_load_value(load, pair->value, &changed);
+          if (!mrb_immediate_p(pair->key) && !mrb_string_p(pair->key)) rehash = TRUE;
+        }
+
+        if (rehash) MRB(mrb_hash_clear)(mrb, value);
+        for (size_t idx = 0; (rehash || changed) && idx < load->count; idx++) {
+          MRB(mrb_hash_set)(mrb, value, load->pairs[idx].key, load->pairs[idx].value);
+        }
+      }
+
+      load->count = 0;
+      changed = FALSE;
+      MRB(mrb_iv_foreach)(mrb, value, gc_arena_load_ivar, load);
+      for (size_t idx = 0; idx < load->count; idx++) {
+        gc_arena_load_value(load, load->pairs[idx].key, &changed);
+        gc_arena_load_value(load, load->pairs[idx].value, &changed);
+      }
+
+      // Every variable is removed before any are set, as a variable's new name
+      // may be another's old one.
+      for (size_t idx = 0; changed && idx < load->count; idx++) {
+        MRB(mrb_iv_remove)(mrb, value, mrb_symbol(load->pairs[idx].key));
+      }
+      for (size_t idx = 0; changed && idx < load->count; idx++) {
+        struct gc_arena_load_pair *pair = &load->pairs[idx];
+        mrb_sym sym = gc_arena_load_symbol(load, mrb_symbol(pair->key));
+        MRB(mrb_iv_set)(mrb, value, sym, gc_arena_load_value(load, pair->value, &changed));
+      }
+
+      if (frozen) MRB_SET_FROZEN_FLAG(obj);
+    }
+  }
+
+  return mrb_nil_value();
+}
+
+#define gc_arena_promote_push(list, count, capa, entry) \
+  do { \
+    if ((count) == (capa)) { \
+      (capa) = (capa) ? (capa) * 2 : 64; \
+      (list) = realloc((list), sizeof(*(list)) * (capa)); \
+    } \
+    (list)[(count)++] = (entry); \
+  } while (0)
+
+// Finds the copy of an object, or NULL if it hasn't been copied.
+static struct RBasic *gc_arena_promote_lookup(struct gc_arena_promote *promote, struct RBasic *from) {
+  if (!promote->capa) return NULL;
+
+  size_t slot = gc_arena_image_hash((uintptr_t)from, promote->capa);
+  while (promote->map[slot].from) {
+    if (promote->map[slot].from == from) return promote->map[slot].to;
+    slot = (slot + 1) & (promote->capa - 1);
+  }
+
+  return NULL;
+}
+
+static void gc_arena_promote_insert(struct gc_arena_promote *promote, struct RBasic *from, struct RBasic *to) {
+  if ((promote->count + 1) * 2 > promote->capa) {
+    struct gc_arena_promote_entry *map = promote->map;
+    size_t capa = promote->capa;
+    promote->capa = capa ? capa * 2 : 256;
+    promote->map = calloc(promote->capa, sizeof(struct gc_arena_promote_entry));
+    promote->count = 0;
+
+    for (size_t idx = 0; idx < capa; idx++) {
+      if (map[idx].from) gc_arena_promote_insert(promote, map[idx].from, map[idx].to);
+    }
+    free(map);
+  }
+
+  size_t slot = gc_arena_image_hash((uintptr_t)from, promote->capa);
+  while (promote->map[slot].from) slot = (slot + 1) & (promote->capa - 1);
+  promote->map[slot] = (struct gc_arena_promote_entry){.from = from, .to = to};
+  promote->count++;
+}
+
+static void gc_arena_promote_free(struct gc_arena_promote *promote) {
+  free(promote->map);
+  free(promote->pending);
+  free(promote->rehash);
+  free(promote->pairs);
+}
+
+// Whether a class lives in an Arena other than the one being promoted into,
+// and so may be reset out from under the copies.
+static mrb_bool gc_arena_promote_foreign(struct gc_arena_promote *promote, struct RClass *cls) {
+  struct gc_arena_range *range = gc_arena_index_find(promote->arena->registry, cls);
+  return range && range->arena != promote->arena;
+}
+
+// Returns the copy of a value in the active Arena, allocating it if needed.
+// Only strings are copied in full here; the contents of other objects are
+// filled in later, from the pending list, so that deep graphs don't recurse.
+static mrb_value gc_arena_promote_value(mrb_state *mrb, struct gc_arena_promote *promote, mrb_value value) {
+  if (promote->error || mrb_immediate_p(value)) return value;
+
+  enum mrb_vtype tt = mrb_type(value);
+  struct RBasic *from = mrb_basic_ptr(value);
+  if (is_in_arena(promote->arena, from)) return value;
+  if (tt == MRB_TT_CLASS || tt == MRB_TT_MODULE || tt == MRB_TT_SCLASS) {
+    if (gc_arena_promote_foreign(promote, (struct RClass *)from)) {
+      promote->error = "Classes defined within another Arena can't be promoted.";
+      return mrb_nil_value();
+    }
+    return value;
+  }
+
+  // Copies keep their original's class, which must outlive the source Arena.
+  if (from->c && (from->c->tt == MRB_TT_SCLASS || gc_arena_promote_foreign(promote, from->c))) {
+    promote->error = "Objects with singleton classes, or classes defined within another Arena, can't be promoted.";
+    return mrb_nil_value();
+  }
+
+  struct RBasic *to = gc_arena_promote_lookup(promote, from);
+  if (to) return mrb_obj_value(to);
+
+  mrb_value copy;
+  switch (tt) {
+    case MRB_TT_FLOAT:
+      return mrb_float_value(mrb, mrb_float(value));
+
+    case MRB_TT_STRING:
+      copy = MRB(mrb_str_new)(mrb, RSTRING_PTR(value), RSTRING_LEN(value));
+      break;
+
+    case MRB_TT_ARRAY:
+      copy = MRB(mrb_ary_new_capa)(mrb, RARRAY_LEN(value));
+      break;
+
+    case MRB_TT_HASH:
+      copy = MRB(mrb_hash_new_capa)(mrb, MRB(mrb_hash_size)(mrb, value));
+      break;
+
+    case MRB_TT_OBJECT:
+      copy = mrb_obj_value(MRB(mrb_obj_alloc)(mrb, MRB_TT_OBJECT, from->c));
+      break;
+
+    default:
+      promote->error = "Only plain objects, strings, arrays, hashes and numbers can be promoted.";
+      return mrb_nil_value();
+  }
+
+  to = mrb_basic_ptr(copy);
+  to->c = from->c;
+  gc_arena_promote_insert(promote, from, to);
+
+  struct gc_arena_promote_entry entry = {.from = from, .to = to};
+  if (tt == MRB_TT_STRING) {
+    if (MRB_FROZEN_P(from)) MRB_SET_FROZEN_FLAG(to);
+  } else {
+    gc_arena_promote_push(promote->pending, promote->pending_count, promote->pending_capa, entry);
+  }
+
+  return copy;
+}
+
+static int gc_arena_promote_pair(mrb_state *mrb, mrb_value key, mrb_value value, void *data) {
+  struct gc_arena_promote *promote = data;
+  struct gc_arena_load_pair pair = {.key = key, .value = value};
+  gc_arena_promote_push(promote->pairs, promote->pair_count, promote->pair_capa, pair);
+  return 0;
+}
+
+static int gc_arena_promote_ivar(mrb_state *mrb, mrb_sym sym, mrb_value value, void *data) {
+  return gc_arena_promote_pair(mrb, mrb_symbol_value(sym), value, data);
+}
+
+// Copies an object graph into the active Arena, returning the copy of the root.
+static mrb_value gc_arena_promote_objects(mrb_state *mrb, void *data) {
+  struct gc_arena_promote *promote = data;
+  mrb_value root = gc_arena_promote_value(mrb, promote, promote->root);
+
+  while (promote->pending_count && !promote->error) {
+    struct gc_arena_promote_entry entry = promote->pending[--promote->pending_count];
+    mrb_value from = mrb_obj_value(entry.from);
+    mrb_value to = mrb_obj_value(entry.to);
+    mrb_bool rehash = FALSE;
+
+    // Arrays have been allocated at their final size, so never grow here.
+    if (entry.from->tt == MRB_TT_ARRAY) {
+      for (mrb_int idx = 0; idx < RARRAY_LEN(from); idx++) {
+        MRB(mrb_ary_push)(mrb, to, gc_arena_promote_value(mrb, promote, RARRAY_PTR(from)[idx]));
+      }
+    } else if (entry.from->tt == MRB_TT_HASH) {
+      promote->pair_count = 0;
+      MRB(mrb_hash_foreach)(mrb, mrb_hash_ptr(from), gc_arena_promote_pair, promote);
+      for (size_t idx = 0; idx < promote->pair_count; idx++) {
+        struct gc_arena_load_pair *pair = &promote->pairs[idx];
+        mrb_value key = gc_arena_promote_value(mrb, promote, pair->key);
+        mrb_value value = gc_arena_promote_value(mrb, promote, pair->value);
+
+        // Arrays and hashes are hashed by their contents, which may not have
+        // been filled in yet.
+        if (mrb_array_p(key) || mrb_hash_p(key)) rehash = TRUE;
+        MRB(mrb_hash_set)(mrb, to, key, value);
+      }
+    }
+
+    promote->pair_count = 0;
+    MRB(mrb_iv_foreach)(mrb, from, gc_arena_promote_ivar, promote);
+    for (size_t idx = 0; idx < promote->pair_count; idx++) {
+      struct gc_arena_load_pair *pair = &promote->pairs[idx];
+      MRB(mrb_iv_set)(mrb, to, mrb_symbol(pair->key), gc_arena_promote_value(mrb, promote, pair->value));
+    }
+
+    if (rehash) {
+      gc_arena_promote_push(promote->rehash, promote->rehash_count, promote->rehash_capa, entry);
+    } else if (MRB_FROZEN_P(entry.from)) {
+      MRB_SET_FROZEN_FLAG(entry.to);
+    }
+  }
+
+  for (size_t idx = 0; idx < promote->rehash_count && !promote->error; idx++) {
+    struct gc_arena_promote_entry *entry = &promote->rehash[idx];
+    MRB(mrb_funcall)(mrb, mrb_obj_value(entry->to), "rehash", 0);
+    if (MRB_FROZEN_P(entry->from)) MRB_SET_FROZEN_FLAG(entry->to);
+  }
+
+  return root;
+}
+
+// Allocates a Ring of Arenas, with each generation's initial page carved from a
+// single shared allocation.
+struct gc_arena_ring *gc_arena_ring_allocate(mrb_state *mrb, size_t count, size_t object_count, size_t storage_bytes) {
+  size_t gc_arena_size = round_up(gc_arena_initial_size(object_count, storage_bytes), sizeof(void *));
+  struct gc_arena_ring *ring = malloc(sizeof(struct gc_arena_ring) + sizeof(struct gc_arena *) * count);
+  *ring = (struct gc_arena_ring){.memory = malloc(gc_arena_size * count), .count = count};
+
+  for (size_t idx = 0; idx < count; idx++) {
+    struct gc_arena *arena = gc_arena_setup(gc_arena_registry_for(mrb), ring->memory + gc_arena_size * idx, gc_arena_size, NULL, object_count);
+    arena->page->shared = TRUE;
+    ring->generations[idx] = arena;
+  }
+
+  return ring;
+}
+
+static void gc_arena_ring_free(mrb_state *mrb, void *ptr) {
+  struct gc_arena_ring *ring = ptr;
+  for (size_t idx = 0; idx < ring->count; idx++) {
+    gc_arena_free(mrb, ring->generations[idx]);
+  }
+
+  free(ring->memory);
+  free(ring);
+}
+
+// Makes the oldest generation current, discarding everything allocated within
+// it.
+static void gc_arena_ring_advance(mrb_state *mrb, struct gc_arena_ring *ring) {
+  gc_arena_track_peaks(ring->generations[ring->current]);
+  ring->current = (ring->current + 1) % ring->count;
+  gc_arena_reset(mrb, ring->generations[ring->current]);
+}
+
+size_t gc_arena_page_available(struct gc_arena_page *page) {
+  return page->end - page->ptr;
+}
+
+#pragma endregion
+
+#pragma region Ruby Interface
+
+/*
+ * Document-class: GC::Arena
+ *
+ * Arena-style memory management in Ruby.
+ */
+
+/*
+ * Document-method: GC::Arena.allocate
+ *
+ * Allocates a new `GC::Arena`, reserving a pool of memory for objects and their
+ * backing data.
+ *
+ * When the preallocated memory is exhausted, the Arena grows by allocating
+ * additional pages. By default, each page holds the triggering allocation plus
+ * a fixed `page_size` bytes; Arenas that are expected to overflow by a wide
+ * margin may prefer `growth: :geometric`, which multiplies the size of each new
+ * page by `growth_factor` (up to `max_page_size`), trading a little unused
+ * memory for far fewer allocations.
+ *
+ * Object slots beyond the preallocated `objects` are kept apart from storage,
+ * in object pages of their own holding `object_page_size` objects (rounded up
+ * to whole mruby heap pages), grown by the same policy. Keeping slots densely
+ * packed makes iterating over many Arena objects far friendlier to the cache.
+ *
+ * Overflow and object pages are normally freed when the Arena is reset. Arenas
+ * that overflow by a similar amount between each reset can instead `retain` up
+ * to the given number of bytes of those pages for reuse, and optionally
+ * `coalesce` them into a single page of each kind sized to the most seen. Once
+ * warmed up, such an Arena performs no further system allocations.
+ *
+ * Storage released by mruby (from freed or resized strings, arrays and hashes)
+ * is normally abandoned until the Arena is reset. Long-lived Arenas with
+ * frequently mutated data can opt to `recycle` that storage instead, reusing
+ * released blocks of a similar size for new allocations. Recycling Arenas also
+ * pack blocks of up to 256 bytes into runs of a single size, without the size
+ * header every other block carries.
+ *
+ * Alternatively, an Arena can `reserve` a large range of address space up
+ * front, committing memory from it only as needed. Such Arenas remain
+ * contiguous as they grow (until the reservation is exhausted), and return
+ * memory to the operating system on reset without freeing it. Very large
+ * Arenas may also benefit from `huge_pages`, where supported. Page growth and
+ * retention settings only apply once the reservation is exhausted.
+ *
+ * Arenas may be allocated anywhere, including within another Arena's
+ * {GC::Arena#eval}; the `GC::Arena` object itself always lives in the GC heap.
+ *
+ * Arenas grow without limit by default. To keep a subsystem within a memory
+ * budget, an Arena may be capped at `max_objects` object slots and
+ * `max_storage` bytes of storage (counted as for `total_objects` and
+ * `total_storage` in {GC::Arena#stats}). Allocations beyond those limits are
+ * handled according to `on_overflow`:
+ *
+ * * `:raise` fails the allocation, raising a `NoMemoryError`.
+ * * `:fallback` serves the allocation from the default allocator instead. Such
+ *   allocations still belong to the Arena, and are freed when it is reset.
+ * * A Proc falls back as `:fallback` does, and is told about it once the
+ *   {GC::Arena#eval} (or {GC::Arena#leave}) that overflowed returns. It is
+ *   called with the kind of allocation (`:objects` or `:storage`) and the bytes
+ *   that fell back, and may raise an error of its own from that call. Mruby
+ *   cannot run Ruby code from within its allocator, so the Proc can neither
+ *   veto an allocation nor run in the middle of one; overflows during an eval
+ *   that raises are reported after the next one returns.
+ *
+ * @example Bounded Subsystem
+ *   $particles = GC::Arena.allocate(objects: 4096, max_objects: 8192, max_storage: 1024 * 1024, on_overflow: :fallback)
+ *
+ * @overload allocate(objects:, storage: 0, growth: :fixed, growth_factor: 2, page_size: 49152, max_page_size: 67108864, retain: 0, coalesce: false, recycle: false, reserve: nil, huge_pages: false, max_objects: nil, max_storage: nil, on_overflow: :raise, object_page_size: 8192)
+ *   @param objects [Integer] The number of objects to allocate space for.
+ *   @param storage [Integer] Additional bytes of storage to allocate.
+ *   @param growth [Symbol] The page growth policy; `:fixed` or `:geometric`.
+ *   @param growth_factor [Numeric] The multiplier for geometric page growth.
+ *   @param page_size [Integer] The size (in bytes) of the first overflow page.
+ *   @param max_page_size [Integer] The largest page geometric growth will produce.
+ *   @param retain [Integer] The number of bytes of overflow pages to keep across resets.
+ *   @param coalesce [Boolean] Whether to merge retained pages into a single page.
+ *   @param recycle [Boolean] Whether to reuse storage released by mruby.
+ *   @param reserve [Integer] The number of bytes of address space to reserve.
+ *   @param huge_pages [Boolean] Whether to request huge pages for the reservation.
+ *   @param max_objects [Integer] The most object slots the Arena may hold.
+ *   @param max_storage [Integer] The most bytes of storage the Arena may hold.
+ *   @param on_overflow [Symbol, Proc] The policy for allocations beyond the limits; `:raise`, `:fallback` or a Proc.
+ *   @param object_page_size [Integer] The number of objects each object page holds.
+ #   @return GC::Arena
+ */
+mrb_value gc_arena_allocate_cm(mrb_state *mrb, mrb_value cls) {
+  mrb_value values[15];
+  const mrb_kwargs kwargs = {
+    .num = 15,
+    .required = 1,
+    .table = (const mrb_sym[15]){
+      MRB(mrb_intern_static)(mrb, "objects", 7),
+      MRB(mrb_intern_static)(mrb, "storage", 7),
+      MRB(mrb_intern_static)(mrb, "growth", 6),
+      MRB(mrb_intern_static)(mrb, "growth_factor", 13),
+      MRB(mrb_intern_static)(mrb, "page_size", 9),
+      MRB(mrb_intern_static)(mrb, "max_page_size", 13),
+      MRB(mrb_intern_static)(mrb, "retain", 6),
+      MRB(mrb_intern_static)(mrb, "coalesce", 8),
+      MRB(mrb_intern_static)(mrb, "recycle", 7),
+      MRB(mrb_intern_static)(mrb, "reserve", 7),
+      MRB(mrb_intern_static)(mrb, "huge_pages", 10),
+      MRB(mrb_intern_static)(mrb, "max_objects", 11),
+      MRB(mrb_intern_static)(mrb, "max_storage", 11),
+      MRB(mrb_intern_static)(mrb, "on_overflow", 11),
+      MRB(mrb_intern_static)(mrb, "object_page_size", 16),
+    },
+    .values = values,
+  };
+  MRB(mrb_get_args)(mrb, ":", &kwargs);
+  if (mrb_undef_p(values[1])) values[1] = mrb_fixnum_value(0);
+
+  mrb_int max_objects = mrb_undef_p(values[11]) || mrb_nil_p(values[11]) ? 0 : mrb_fixnum(values[11]);
+  mrb_int max_storage = mrb_undef_p(values[12]) || mrb_nil_p(values[12]) ? 0 : mrb_fixnum(values[12]);
+  if (max_objects && max_objects < mrb_fixnum(values[0])) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "max_objects must be at least objects");
+  }
+  if (max_storage && max_storage < mrb_fixnum(values[1])) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "max_storage must be at least storage");
+  }
+
+  enum gc_arena_overflow_policy on_overflow = GC_ARENA_OVERFLOW_RAISE;
+  if (!mrb_undef_p(values[13]) && mrb_type(values[13]) == MRB_TT_PROC) {
+    on_overflow = GC_ARENA_OVERFLOW_HOOK;
+  } else if (!mrb_undef_p(values[13])) {
+    mrb_sym policy = mrb_symbol_p(values[13]) ? mrb_symbol(values[13]) : 0;
+    if (policy == MRB(mrb_intern_static)(mrb, "fallback", 8)) {
+      on_overflow = GC_ARENA_OVERFLOW_FALLBACK;
+    } else if (policy != MRB(mrb_intern_static)(mrb, "raise", 5)) {
+      MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "on_overflow must be :raise, :fallback or a Proc");
+    }
+  }
+
+  struct gc_arena_growth growth = {
+    .mode = GC_ARENA_GROWTH_FIXED,
+    .factor = 2,
+    .page_size = GC_ARENA_PAGE_SIZE,
+    .max_page_size = GC_ARENA_MAX_PAGE_SIZE,
+  };
+
+  if (!mrb_undef_p(values[2])) {
+    mrb_sym mode = mrb_symbol_p(values[2]) ? mrb_symbol(values[2]) : 0;
+    if (mode == MRB(mrb_intern_static)(mrb, "geometric", 9)) {
+      growth.mode = GC_ARENA_GROWTH_GEOMETRIC;
+    } else if (mode != MRB(mrb_intern_static)(mrb, "fixed", 5)) {
+      MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "growth must be :fixed or :geometric");
+    }
+  }
+  if (!mrb_undef_p(values[3])) {
+    growth.factor = mrb_float_p(values[3]) ? mrb_float(values[3]) : mrb_fixnum(values[3]);
+    if (growth.factor < 1) {
+      MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "growth_factor must be at least 1");
+    }
+  }
+  if (!mrb_undef_p(values[4])) growth.page_size = mrb_fixnum(values[4]);
+  if (!mrb_undef_p(values[5])) growth.max_page_size = mrb_fixnum(values[5]);
+  if (growth.max_page_size < growth.page_size) growth.max_page_size = growth.page_size;
+  growth.next_page_size = growth.page_size;
+
+  // Object pages share the growth policy, but are sized in whole heap pages.
+  struct gc_arena_growth object_growth = growth;
+  object_growth.page_size = GC_ARENA_OBJECT_PAGE_SIZE;
+  if (!mrb_undef_p(values[14])) {
+    mrb_int objects = mrb_fixnum(values[14]);
+    if (objects < 1) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "object_page_size must be positive");
+    object_growth.page_size = GC_ARENA_CHUNK_BYTES * ((objects + GC_ARENA_HEAP_SLOTS - 1) / GC_ARENA_HEAP_SLOTS);
+  }
+  if (object_growth.max_page_size < object_growth.page_size) object_growth.max_page_size = object_growth.page_size;
+  object_growth.next_page_size = object_growth.page_size;
+
+  struct gc_arena *arena;
+  if (mrb_undef_p(values[9]) || mrb_nil_p(values[9])) {
+    arena = gc_arena_allocate(mrb, mrb_fixnum(values[0]), mrb_fixnum(values[1]));
+  } else {
+    mrb_bool huge_pages = !mrb_undef_p(values[10]) && mrb_test(values[10]);
+    arena = gc_arena_allocate_vm(mrb, mrb_fixnum(values[0]), mrb_fixnum(values[1]), mrb_fixnum(values[9]), huge_pages);
+    if (!arena) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Unable to reserve memory for Arena.");
+  }
+
+  arena->growth = growth;
+  arena->object_growth = object_growth;
+  if (!mrb_undef_p(values[6])) arena->retain_bytes = mrb_fixnum(values[6]);
+  if (!mrb_undef_p(values[7])) arena->coalesce = mrb_test(values[7]);
+  if (!mrb_undef_p(values[8])) gc_arena_set_recycle(arena, mrb_test(values[8]));
+  arena->max_objects = max_objects;
+  arena->max_storage = max_storage;
+  arena->on_overflow = on_overflow;
+
+  struct RData *obj = gc_arena_data_object_alloc(mrb, mrb_class_ptr(cls), arena, &gc_arena_data_type);
+
+  // The hook is kept alive by the Arena object.
+  if (on_overflow == GC_ARENA_OVERFLOW_HOOK) {
+    arena->overflow_hook = values[13];
+    MRB(mrb_iv_set)(mrb, mrb_obj_value(obj), MRB(mrb_intern_static)(mrb, "__on_overflow__", 15), values[13]);
+  }
+
+  return mrb_obj_value(obj);
+}
+
+/*
+ * Document-method: GC::Arena#eval
+ *
+ * Substitutes this Arena in place of the current object pool and allocator,
+ * forcing object creation within the given block to occur within this Arena.
+ *
+ * * Calls to `GC::Arena#eval` may be nested, for the same Arena or others; each
+ *   restores the Arena (or GC heap) it was nested in when it returns. Use
+ *   {GC::Arena.outer} to allocate in that enclosing context from within.
+ * * Allocations performed by C extensions will also utilize this Arena if they
+ *   perform allocations using the mruby provided APIs.
+ *
+ * @yield Nothing.
+ * @return The block's result.
+ */
+mrb_value gc_arena_eval_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value block;
+  MRB(mrb_get_args)(mrb, "&", &block);
+
+  return gc_arena_eval(mrb, arena, block);
+}
+
+/*
+ * Document-method: GC::Arena#enter
+ *
+ * Switches into this Arena until the matching {GC::Arena#leave}, as
+ * {GC::Arena#eval} does for the duration of a block. Switching this way costs
+ * little more than a method call, and suits tight loops which step in and out
+ * of an Arena for each item. The Arena is kept from being collected until it
+ * is left.
+ *
+ * > [!IMPORTANT]
+ * > Unlike {GC::Arena#eval}, nothing leaves the Arena if an exception is
+ * > raised before {GC::Arena#leave}; use `ensure` where that matters. Entered
+ * > Arenas are left automatically when an enclosing {GC::Arena#eval} returns.
+ *
+ * @example Building a List of Arena Objects
+ *   list = points.map do |point|
+ *     $arena.enter
+ *     pos = {x: point.x, y: point.y}
+ *     $arena.leave
+ *     pos
+ *   end
+ *
+ * @return [nil]
+ */
+mrb_value gc_arena_enter_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  if (!gc_arena_enter(mrb, arena, self)) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Too many Arenas entered.");
+  }
+
+  return mrb_nil_value();
+}
+
+/*
+ * Document-method: GC::Arena#leave
+ *
+ * Switches out of this Arena, back to the Arena (or GC heap) that was active
+ * when {GC::Arena#enter} was called.
+ *
+ * @return [nil]
+ */
+mrb_value gc_arena_leave_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  if (!gc_arena_leave(mrb, arena)) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "GC::Arena#leave must follow a matching GC::Arena#enter.");
+  }
+
+  gc_arena_overflow_notify(mrb, arena);
+  return mrb_nil_value();
+}
+
+/*
+ * Document-method: GC::Arena#eval_each
+ *
+ * Yields each item within this Arena, collecting the block's results into a
+ * new Array outside of it. This is equivalent to (but much cheaper than)
+ * calling {GC::Arena#eval} once per item.
+ *
+ * @example Building a List of Arena Objects
+ *   list = $arena.eval_each(points) { |point| {x: point.x, y: point.y} }
+ *
+ * @param items [Array] The items to yield.
+ * @yield [item] Each item in turn.
+ * @return [Array] The block's results.
+ */
+mrb_value gc_arena_eval_each_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value items, block;
+  MRB(mrb_get_args)(mrb, "A&", &items, &block);
+
+  struct gc_arena_each each = {
+    .arena = arena,
+    .caller = mrb->allocf_ud,
+    .items = items,
+    .block = block,
+    .results = MRB(mrb_ary_new_capa)(mrb, RARRAY_LEN(items)),
+  };
+  return gc_arena_eval_func(mrb, arena, gc_arena_each_items, &each);
+}
+
+static mrb_value gc_arena_collection_m(mrb_state *mrb, mrb_value self, enum gc_arena_collection_type type) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_int capacity;
+  MRB(mrb_get_args)(mrb, "i", &capacity);
+  if (capacity < 0) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "capacity must not be negative");
+
+  struct gc_arena_collection collection = {.type = type, .capacity = capacity, .items = mrb_nil_value()};
+  return gc_arena_eval_func(mrb, arena, gc_arena_new_collection, &collection);
+}
+
+/*
+ * Document-method: GC::Arena#array
+ *
+ * Creates an empty Array within this Arena, with room for `capacity` elements.
+ *
+ * Collections grown one element at a time are reallocated as they grow, and
+ * within an Arena each outgrown copy remains in the Arena's storage until it
+ * is reset. Building a large Array this way can take roughly twice the storage
+ * its contents need; allocating at the final size up front takes exactly one
+ * allocation, and wastes nothing.
+ *
+ * @example Loading Level Chunks
+ *   chunks = $level.array(LEVEL_CHUNKS.size)
+ *   LEVEL_CHUNKS.each { |chunk| chunks << $level.eval { load_chunk(chunk) } }
+ *
+ * @param capacity [Integer] The number of elements to allocate space for.
+ * @return [Array]
+ */
+mrb_value gc_arena_array_m(mrb_state *mrb, mrb_value self) {
+  return gc_arena_collection_m(mrb, self, GC_ARENA_COLLECTION_ARRAY);
+}
+
+/*
+ * Document-method: GC::Arena#hash_with_capacity
+ *
+ * Creates an empty Hash within this Arena, with room for `capacity` entries.
+ * See {GC::Arena#array} for why this is preferable to growing a Hash in place.
+ * (`GC::Arena#hash` remains `Object#hash`, so that Arenas are usable as Hash
+ * keys.)
+ *
+ * @param capacity [Integer] The number of entries to allocate space for.
+ * @return [Hash]
+ */
+mrb_value gc_arena_hash_with_capacity_m(mrb_state *mrb, mrb_value self) {
+  return gc_arena_collection_m(mrb, self, GC_ARENA_COLLECTION_HASH);
+}
+
+/*
+ * Document-method: GC::Arena#string
+ *
+ * Creates an empty String within this Arena, with room for `capacity` bytes.
+ * See {GC::Arena#array} for why this is preferable to growing a String in
+ * place.
+ *
+ * @param capacity [Integer] The number of bytes to allocate space for.
+ * @return [String]
+ */
+mrb_value gc_arena_string_m(mrb_state *mrb, mrb_value self) {
+  return gc_arena_collection_m(mrb, self, GC_ARENA_COLLECTION_STRING);
+}
+
+/*
+ * Document-method: GC::Arena#array_from
+ *
+ * Creates an Array within this Arena from the given items, allocating its
+ * storage once. With a block, each item is yielded within this Arena and the
+ * block's results are stored instead.
+ *
+ * Items which are not already an Array are converted with `to_a` outside of
+ * this Arena.
+ *
+ * @example Copying Level Data
+ *   labels = $level.array_from(LEVEL_CHUNKS) { |chunk| chunk.label.dup }
+ *
+ * @param items [Array, Enumerable] The items to copy.
+ * @param size [Integer] The capacity to allocate; defaults to the number of
+ *   items. Extra capacity leaves room for later appends.
+ * @yield [item] Each item in turn.
+ * @return [Array]
+ */
+mrb_value gc_arena_array_from_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value items, block, values[1];
+  const mrb_kwargs kwargs = {
+    .num = 1,
+    .table = (const mrb_sym[1]){MRB(mrb_intern_static)(mrb, "size", 4)},
+    .values = values,
+  };
+  MRB(mrb_get_args)(mrb, "o:&", &items, &kwargs, &block);
+
+  if (!mrb_array_p(items)) items = MRB(mrb_funcall)(mrb, items, "to_a", 0);
+  mrb_int capacity = mrb_undef_p(values[0]) ? RARRAY_LEN(items) : mrb_fixnum(values[0]);
+  if (capacity < 0) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "size must not be negative");
+
+  struct gc_arena_collection collection = {
+    .type = GC_ARENA_COLLECTION_ARRAY,
+    .capacity = capacity,
+    .items = items,
+    .block = block,
+  };
+  return gc_arena_eval_func(mrb, arena, gc_arena_new_collection, &collection);
+}
+
+/*
+ * Document-method: GC::Arena#intern
+ *
+ * Returns a frozen String within this Arena with the same contents as `str`,
+ * reusing the one returned by a previous call with equal contents, if any.
+ * Data with many repeated strings (like labels and names) can then share a
+ * single copy of each.
+ *
+ * Interned strings are tracked by a table within the Arena's storage, which is
+ * discarded whenever the Arena is reset or rewound; strings interned after
+ * that are copied afresh. Frozen strings already within this Arena are
+ * interned as they are.
+ *
+ * @example Deduplicating Labels
+ *   $level.eval do
+ *     @tiles = chunk.tiles.map { |tile| {kind: $level.intern(tile.kind)} }
+ *   end
+ *
+ * @param str [String] The contents to intern.
+ * @return [String] The interned String.
+ */
+mrb_value gc_arena_intern_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value str;
+  MRB(mrb_get_args)(mrb, "S", &str);
+
+  uint64_t hash = gc_arena_intern_hash(RSTRING_PTR(str), RSTRING_LEN(str));
+  struct RString *found = gc_arena_intern_find(arena, RSTRING_PTR(str), RSTRING_LEN(str), hash);
+  if (found) {
+    arena->counters.deduplicated += RSTRING_LEN(str);
+    return mrb_obj_value(found);
+  }
+
+  mrb_value interned = str;
+  if (!MRB_FROZEN_P(mrb_str_ptr(str)) || !is_in_arena(arena, mrb_ptr(str))) {
+    interned = gc_arena_eval_func(mrb, arena, gc_arena_intern_copy, &str);
+  }
+
+  gc_arena_intern_insert(arena, mrb_str_ptr(interned), hash);
+  return interned;
+}
+
+/*
+ * Document-method: GC::Arena.outer
+ *
+ * Evaluates the given block in the context enclosing the current
+ * {GC::Arena#eval}: the Arena it was nested within, or the GC heap. Calls may
+ * be nested to step out further. Outside of any Arena, this simply yields.
+ *
+ * This allows a short-lived scratch Arena to do the bulk of the work, while its
+ * results are built in the longer-lived Arena it was called from.
+ *
+ * @example Keeping Results from Scratch Work
+ *   $level.eval do
+ *     $scratch.eval do
+ *       path = find_path(from, to)
+ *       @path = GC::Arena.outer { path.map(&:dup) }
+ *     end
+ *   end
+ *
+ * @yield Nothing.
+ * @return The block's result.
+ */
+mrb_value gc_arena_outer_cm(mrb_state *mrb, mrb_value cls) {
+  mrb_value block;
+  MRB(mrb_get_args)(mrb, "&", &block);
+
+  return gc_arena_outer(mrb, block);
+}
+
+/*
+ * Document-method: GC::Arena#reset
+ *
+ * Resets the Arena's allocator.
+ *
+ * > [!IMPORTANT]
+ * > This will invalidate references to every object in this Arena! It is your
+ * > responsibility to ensure that you no longer reference those objects.
+ *
+ * This enables scratch and periodic Arenas to quickly and quietly discard all
+ * data and prepare for further use. Manually resetting is faster than
+ * allocating a new Arena, and substantially faster than delegating to the GC.
+ *
+ * @example Scratch Storage
+ *   $scratch = Arena.new(objects: 2048)
+ *   def tick(...)
+ *     $scratch.reset
+ *     $scratch.eval do
+ *       simulate_game
+ *       render_game
+ *     end
+ *   end
+ *
+ * @return [nil]
+ */
+mrb_value gc_arena_reset_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+  gc_arena_reset(mrb, arena);
+  if (mrb->allocf_ud == arena) mrb->gc = arena->gc;
+  return mrb_nil_value();
+}
+
+/*
+ * Document-class: GC::Arena::Mark
+ *
+ * An opaque savepoint, returned by {GC::Arena#mark}. Marks are held outside of
+ * the Arena, and remain valid until the Arena is reset or rewound past them.
+ */
+
+/*
+ * Document-method: GC::Arena#mark
+ *
+ * Captures the current allocation state of the Arena, for use with
+ * {GC::Arena#rewind}.
+ *
+ * @example Temporary Storage
+ *   $level.eval do
+ *     mark = $level.mark
+ *     path = find_path(from, to)
+ *     follow(path)
+ *     $level.rewind(mark)
+ *   end
+ *
+ * @return [GC::Arena::Mark] An opaque savepoint.
+ */
+mrb_value gc_arena_mark_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+
+  struct RClass *cls = MRB(mrb_class_get_under)(mrb, MRB(mrb_obj_class)(mrb, self), "Mark");
+  struct gc_arena_savepoint *savepoint = gc_arena_savepoint_new(arena);
+  TRACE(GC_ARENA_TRACE_MARK, arena, gc_arena_trace_assign(savepoint), 0);
+
+  return mrb_obj_value(gc_arena_data_object_alloc(mrb, cls, savepoint, &gc_arena_savepoint_data_type));
+}
+
+/*
+ * Document-method: GC::Arena#rewind
+ *
+ * Rolls the Arena back to the given savepoint, reclaiming every object and all
+ * storage allocated since {GC::Arena#mark} was called. Data allocated before
+ * the mark is unaffected.
+ *
+ * > [!IMPORTANT]
+ * > This will invalidate references to every object allocated after the mark!
+ * > Savepoints are themselves invalidated by {GC::Arena#reset}, and by rewinding
+ * > to an earlier savepoint.
+ *
+ * @param mark [GC::Arena::Mark] A savepoint returned by {GC::Arena#mark}.
+ * @raise [ArgumentError] If the savepoint was taken from another Arena, or has
+ *   since been invalidated.
+ * @return [nil]
+ */
+mrb_value gc_arena_rewind_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value mark;
+  MRB(mrb_get_args)(mrb, "o", &mark);
+
+  struct gc_arena_savepoint *savepoint = MRB(mrb_get_datatype)(mrb, mark, &gc_arena_savepoint_data_type);
+  if (savepoint->arena != arena) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "Invalid Arena savepoint.");
+  }
+
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+  TRACE(GC_ARENA_TRACE_REWIND, arena, gc_arena_trace_lookup(savepoint, FALSE), 0);
+  gc_arena_savepoint_rewind(arena, savepoint);
+  if (mrb->allocf_ud == arena) mrb->gc = arena->gc;
+  return mrb_nil_value();
+}
+
+/*
+ * Document-method: GC::Arena#reserve
+ *
+ * Grows the Arena ahead of a known burst of allocations (e.g. a level load or
+ * a large wave of spawns), adding room for the given number of objects and
+ * bytes of storage in a single allocation. Object slots are prepared up front,
+ * so the burst itself needn't allocate or prepare any memory.
+ *
+ * Reserved capacity is used after any remaining preallocated capacity, and
+ * lasts until the Arena is next reset. Reservations count towards the Arena's
+ * limits, and raise if they would exceed them.
+ *
+ * @example Preparing for a Level Load
+ *   $level.reserve(objects: 50_000, storage: 4 * 1024 * 1024)
+ *   $level.eval { load_level(name) }
+ *
+ * @param objects [Integer] The number of objects to reserve space for.
+ * @param storage [Integer] The number of bytes of storage to reserve.
+ * @return [nil]
+ */
+mrb_value gc_arena_reserve_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+
+  mrb_value values[2];
+  const mrb_kwargs kwargs = {
+    .num = 2,
+    .table = (const mrb_sym[2]){
+      MRB(mrb_intern_static)(mrb, "objects", 7),
+      MRB(mrb_intern_static)(mrb, "storage", 7),
+    },
+    .values = values,
+  };
+  MRB(mrb_get_args)(mrb, ":", &kwargs);
+
+  mrb_int objects = mrb_undef_p(values[0]) ? 0 : mrb_fixnum(values[0]);
+  mrb_int storage = mrb_undef_p(values[1]) ? 0 : mrb_fixnum(values[1]);
+  if (objects < 0 || storage < 0) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "objects and storage must not be negative");
+  }
+
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+  mrb_bool reserved = gc_arena_reserve(arena, objects, storage);
+  if (mrb->allocf_ud == arena) mrb->gc = arena->gc;
+
+  if (!reserved) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Reservation exceeds the Arena's limits.");
+  return mrb_nil_value();
+}
+
+#define STAT_KEY(name) {#name, sizeof(#name) - 1, offsetof(struct gc_arena_stats, name)}
+
+static const struct {
+  const char *name;
+  size_t len;
+  size_t offset;
+} gc_arena_stat_keys[] = {
+  STAT_KEY(pages),
+  STAT_KEY(average_page_size),
+  STAT_KEY(total_objects),
+  STAT_KEY(live_objects),
+  STAT_KEY(free_objects),
+  STAT_KEY(total_storage),
+  STAT_KEY(used_storage),
+  STAT_KEY(free_storage),
+  STAT_KEY(retained_storage),
+  STAT_KEY(reserved_storage),
+  STAT_KEY(header_storage),
+  STAT_KEY(padding_storage),
+  STAT_KEY(abandoned_storage),
+  STAT_KEY(freed_storage),
+  STAT_KEY(skipped_storage),
+  STAT_KEY(storage_efficiency),
+  STAT_KEY(object_pages),
+  STAT_KEY(object_storage),
+  STAT_KEY(deduplicated_storage),
+  STAT_KEY(max_objects),
+  STAT_KEY(max_storage),
+  STAT_KEY(overflows),
+  STAT_KEY(fallback_objects),
+  STAT_KEY(fallback_storage),
+  STAT_KEY(peak_live_objects),
+  STAT_KEY(peak_used_storage),
+  STAT_KEY(peak_pages),
+};
+
+#define gc_arena_stat_count (sizeof(gc_arena_stat_keys) / sizeof(gc_arena_stat_keys[0]))
+#define stat_value(stats, idx) mrb_fixnum_value(*(size_t *)((void *)(stats) + gc_arena_stat_keys[idx].offset))
+
+// Interns the stat names once for the registry's state, so that reading stats
+// never has to.
+static void gc_arena_intern_stat_keys(mrb_state *mrb, struct gc_arena_registry *registry) {
+  registry->stat_keys = malloc(sizeof(mrb_sym) * gc_arena_stat_count);
+  for (size_t idx = 0; idx < gc_arena_stat_count; idx++) {
+    registry->stat_keys[idx] = MRB(mrb_intern_static)(mrb, gc_arena_stat_keys[idx].name, gc_arena_stat_keys[idx].len);
+  }
+}
+
+static void gc_arena_read_stats(mrb_state *mrb, struct gc_arena *arena, struct gc_arena_stats *stats) {
+  // Sync GC details if the arena is currently "live".
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+  gc_arena_stats(mrb, arena, stats);
+}
+
+// Populates the given Hash with the Arena's stats. Once populated, refilling
+// the same Hash performs no allocations.
+static mrb_value gc_arena_stats_hash(mrb_state *mrb, struct gc_arena *arena, mrb_value hash) {
+  struct gc_arena_stats stats;
+  gc_arena_read_stats(mrb, arena, &stats);
+
+  mrb_sym *keys = gc_arena_registry_for(mrb)->stat_keys;
+  for (size_t idx = 0; idx < gc_arena_stat_count; idx++) {
+    MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(keys[idx]), stat_value(&stats, idx));
+  }
+
+  return hash;
+}
+
+/*
+ * Document-method: GC::Arena#stats
+ *
+ * Provides details about the utilization of this Arena. These details can be
+ * used to determine appropriate values for preallocation, by inspecting these
+ * values either after the Arena has been fully populated or periodically just
+ * before resetting the Arena (to determine a "high water mark" for
+ * object/memory consumption).
+ *
+ * Statistics are maintained as the Arena allocates, so reading them is cheap
+ * regardless of the Arena's size. To avoid allocating a new Hash on every call
+ * (which would itself be allocated into the Arena, if called within
+ * {GC::Arena#eval}), a previously returned Hash may be passed in to be
+ * refilled; see also {GC::Arena#stat}.
+ *
+ * @overload stats(hash = {})
+ *   @param hash [Hash] The Hash to populate.
+ * @return [Hash] Detailed statistics about this Arena.
+ *   * `pages`
+ *       * This indicates the number of memory pages that have been allocated
+ *         since the Arena was created. Numbers greater than `1` indicate that
+ *         usage has exceeded the initialization capacity.
+ *   * `average_page_size`
+ *       * This represents the average size (in bytes) of the pages allocated
+ *         beyond the initialization capacity, as determined by the Arena's
+ *         growth policy.
+ *   * `total_objects`
+ *       * This represents the total number of object slots currently available.
+ *   * `live_objects`
+ *       * This represents the number of object slots which have been filled since
+ *         the Arena was created.
+ *   * `free_objects`
+ *       * This represents the number of unpopulated object slots.
+ *   * `total_storage`
+ *       * This represents the total number of bytes allocated for additional
+ *         object data storage.
+ *   * `used_storage`
+ *       * This represents the number of bytes of additional object storage
+ *         currently being used.
+ *   * `free_storage`
+ *       * This represents the number of bytes allocated but as-yet unused.
+ *       * Note that this number *may* be higher than expected, as data near the
+ *         end of a page may be left indefinitely "free" if the next allocation is
+ *         larger than the remaining available space.
+ *   * `retained_storage`
+ *       * This represents the number of bytes of overflow pages kept across
+ *         resets for reuse, as permitted by the Arena's `retain` budget.
+ *   * `reserved_storage`
+ *       * This represents the number of bytes of address space reserved for
+ *         the Arena, including memory that has not yet been committed.
+ *   * `header_storage`
+ *       * This represents the number of bytes of used storage spent on the
+ *         size tags preceding each allocation (other than those in runs).
+ *   * `padding_storage`
+ *       * This represents the number of bytes of used storage spent padding
+ *         allocations out to their alignment (or, when recycling, their size
+ *         class).
+ *   * `abandoned_storage`, `freed_storage`
+ *       * These represent the number of bytes of used storage held by blocks
+ *         which are no longer in use: those left behind when a reallocation
+ *         had to move them, and those passed to free. Arenas in recycling mode
+ *         don't count blocks which they can reuse.
+ *   * `skipped_storage`
+ *       * This represents the number of bytes of free storage left at the ends
+ *         of pages, when an allocation didn't fit and a new page was added.
+ *   * `storage_efficiency`
+ *       * This represents the share of the storage consumed so far, whether
+ *         used or skipped, which still holds live data, in parts per thousand
+ *         (so that reading it allocates no Float). Low values
+ *         suggest pre-sizing collections (see {GC::Arena#array}), enabling
+ *         `recycle`, or a larger page size.
+ *   * `object_pages`, `object_storage`
+ *       * These represent the number of object pages added for objects beyond
+ *         the preallocated `objects`, and the bytes they hold. Neither is
+ *         included in `pages` or `total_storage`.
+ *   * `deduplicated_storage`
+ *       * This represents the number of bytes of string contents that
+ *         {GC::Arena#intern} has returned without copying, since the Arena was
+ *         last reset.
+ *   * `max_objects`, `max_storage`
+ *       * These represent the Arena's limits, as given to
+ *         {GC::Arena.allocate}, or `0` if unlimited.
+ *   * `overflows`
+ *       * This represents the number of allocations since the Arena was
+ *         created that would have exceeded its limits.
+ *   * `fallback_objects`, `fallback_storage`
+ *       * These represent the number of object slots and bytes of storage
+ *         currently served by the default allocator, for allocations beyond
+ *         the Arena's limits. Neither is included in `total_storage`, though
+ *         `fallback_objects` are included in `total_objects`.
+ *   * `peak_live_objects`, `peak_used_storage`, `peak_pages`
+ *       * These represent the highest values seen for `live_objects`,
+ *         `used_storage` and `pages` since the Arena was created, including
+ *         before any resets or rewinds.
+ */
+mrb_value gc_arena_stats_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value hash = mrb_nil_value();
+  MRB(mrb_get_args)(mrb, "|H", &hash);
+
+  if (mrb_nil_p(hash)) hash = MRB(mrb_hash_new)(mrb);
+  return gc_arena_stats_hash(mrb, arena, hash);
+}
+
+/*
+ * Document-method: GC::Arena#stat
+ *
+ * Reads a single statistic about this Arena, as named by {GC::Arena#stats}.
+ * Unlike {GC::Arena#stats}, this performs no allocations, and is suitable for
+ * use every frame.
+ *
+ * @example Per-frame Monitoring
+ *   $scratch.eval do
+ *     simulate_game
+ *     args.outputs.debug << "objects: #{$scratch.stat(:live_objects)}"
+ *   end
+ *
+ * @param key [Symbol] The name of the statistic.
+ * @return [Integer]
+ */
+mrb_value gc_arena_stat_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_sym key;
+  MRB(mrb_get_args)(mrb, "n", &key);
+
+  struct gc_arena_stats stats;
+  gc_arena_read_stats(mrb, arena, &stats);
 
-  if (tagged_size > page->end - page->ptr) {
-    page = add_page(arena, tagged_size);
+  mrb_sym *keys = gc_arena_registry_for(mrb)->stat_keys;
+  for (size_t idx = 0; idx < gc_arena_stat_count; idx++) {
+    if (key == keys[idx]) return stat_value(&stats, idx);
   }
 
-  uint64_t *tag = page->ptr;
-  page->last = tag + 1;
-
-  *tag = size;
-  page->ptr += tagged_size;
-  return page->last;
+  MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "Unknown Arena statistic.");
+  return mrb_nil_value();
 }
 
-void *gc_arena_allocf(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
-  if (!is_arena(ud) && (!size || !ptr)) return fallback_allocf(mrb, ptr, size, ud);
+#ifdef GC_ARENA_PROFILE
+static const char *gc_arena_vtype_names[MRB_TT_MAXDEFINE] = {
+  [MRB_TT_OBJECT] = "object",
+  [MRB_TT_CLASS] = "class",
+  [MRB_TT_MODULE] = "module",
+  [MRB_TT_ICLASS] = "iclass",
+  [MRB_TT_SCLASS] = "sclass",
+  [MRB_TT_PROC] = "proc",
+  [MRB_TT_ARRAY] = "array",
+  [MRB_TT_HASH] = "hash",
+  [MRB_TT_STRING] = "string",
+  [MRB_TT_RANGE] = "range",
+  [MRB_TT_EXCEPTION] = "exception",
+  [MRB_TT_ENV] = "env",
+  [MRB_TT_DATA] = "data",
+  [MRB_TT_FIBER] = "fiber",
+  [MRB_TT_STRUCT] = "struct",
+  [MRB_TT_ISTRUCT] = "istruct",
+  [MRB_TT_BREAK] = "break",
+  [MRB_TT_COMPLEX] = "complex",
+  [MRB_TT_RATIONAL] = "rational",
+  [MRB_TT_BIGINT] = "bigint",
+};
 
-  // Handle free() calls.
-  if (size == 0) return NULL;
+/*
+ * Document-method: GC::Arena#profile
+ *
+ * Describes how this Arena's memory has been used, to help explain why it
+ * overflowed its preallocated capacity.
+ *
+ * > [!NOTE]
+ * > Profiling is only available in debug builds.
+ *
+ * @return [Hash] A profile of this Arena.
+ *   * `sizes`
+ *       * A Hash counting the storage allocations made since the Arena was
+ *         created, keyed by size class; each class includes allocations
+ *         larger than the previous power of two, up to its key.
+ *   * `realloc_in_place`
+ *       * The number of reallocations satisfied by resizing a block in place.
+ *   * `realloc_copied`
+ *       * The number of reallocations which had to copy data to a new block.
+ *   * `objects`
+ *       * A Hash counting the live objects in the Arena by type (e.g.
+ *         `:string`, `:array`, `:hash`, `:data`).
+ */
+mrb_value gc_arena_profile_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
 
-  // Handle malloc() calls.
-  if (ptr == NULL) return alloc_with_arena(ud, size);
+  // Take the census first, as building the result may allocate objects.
+  size_t census[MRB_TT_MAXDEFINE];
+  gc_arena_census(arena, census);
+  struct gc_arena_profile profile = arena->profile;
 
-  // Handle realloc() calls.
-  struct gc_arena *arena = ud;
-  struct gc_arena_page *page = is_in_arena(arena, ptr);
-  if (!page) {
-    arena = NULL;
-    for (int idx = 0; idx < gc_arena_count; idx++) {
-      page = is_in_arena(&gc_arenas[idx], ptr);
-      if (page) {
-        arena = &gc_arenas[idx];
-        break;
-      }
-    }
+  mrb_value sizes = MRB(mrb_hash_new)(mrb);
+  for (int idx = 0; idx < 64; idx++) {
+    if (profile.sizes[idx]) MRB(mrb_hash_set)(mrb, sizes, mrb_fixnum_value((mrb_int)1 << idx), mrb_fixnum_value(profile.sizes[idx]));
   }
 
-  if (!arena) return fallback_allocf(mrb, ptr, size, ud);
-
-  // Extend the pointer if there's enough space remaining on that page.
-  if (ptr == page->last && ptr + size <= page->end) {
-    ((uint64_t *)ptr)[-1] = size;
-    page->ptr = ptr + size + (8 - size & 7) % 8;
-    return ptr;
+  mrb_value objects = MRB(mrb_hash_new)(mrb);
+  for (int idx = 0; idx < MRB_TT_MAXDEFINE; idx++) {
+    if (!census[idx]) continue;
+    const char *name = gc_arena_vtype_names[idx] ? gc_arena_vtype_names[idx] : "other";
+    mrb_value key = mrb_symbol_value(MRB(mrb_intern_cstr)(mrb, name));
+    mrb_value count = MRB(mrb_hash_get)(mrb, objects, key);
+    MRB(mrb_hash_set)(mrb, objects, key, mrb_fixnum_value((mrb_fixnum_p(count) ? mrb_fixnum(count) : 0) + census[idx]));
   }
 
-  // Step 3: Allocate a new page and copy over the data.
-  void *dest = alloc_with_arena(arena, size);
-  size_t original_size = ((uint64_t *)ptr)[-1];
-  memcpy(dest, ptr, size > original_size ? original_size : size);
-  return dest;
+  mrb_value hash = MRB(mrb_hash_new)(mrb);
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "sizes", 5)), sizes);
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "realloc_in_place", 16)), mrb_fixnum_value(profile.realloc_in_place));
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "realloc_copied", 14)), mrb_fixnum_value(profile.realloc_copied));
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "objects", 7)), objects);
+
+  return hash;
 }
+#endif
 
-static void *gc_arena_initialize_heap(struct mrb_heap_page *heap, size_t count) {
-  ObjectSlot *slot = (ObjectSlot *)heap->objects;
-  ObjectSlot *prev = NULL;
+#ifdef GC_ARENA_TRACE
+/*
+ * Document-method: GC::Arena.trace
+ *
+ * Starts recording every allocation, reallocation and free served by an
+ * Arena to the given file, along with Arena creation, resets, savepoints and
+ * evaluation boundaries. Passing `nil` stops recording.
+ *
+ * Traces can be replayed offline with `build/bin/replay` to evaluate
+ * alternative Arena settings against real workloads.
+ *
+ * > [!NOTE]
+ * > Tracing is only available in debug builds.
+ *
+ * @example Recording a Level
+ *   GC::Arena.trace("level.trace")
+ *   load_level
+ *   GC::Arena.trace(nil)
+ *
+ * @param path [String, nil] The file to write the trace to.
+ * @return [Boolean] Whether the trace was started (or stopped).
+ */
+mrb_value gc_arena_trace_cm(mrb_state *mrb, mrb_value cls) {
+  const char *path;
+  MRB(mrb_get_args)(mrb, "z!", &path);
 
-  while (count--) {
-    slot->as.ptr = (struct RCptr){.tt = MRB_TT_FREE, .p = prev};
-    prev = slot++;
+  if (!path) {
+    mrb_bool tracing = gc_arena_trace_file != NULL;
+    gc_arena_trace_stop();
+    return mrb_bool_value(tracing);
   }
 
-  return prev;
+  return mrb_bool_value(gc_arena_trace_start(gc_arena_registry_for(mrb), path));
 }
+#endif
 
-static void gc_arena_reset(mrb_state *mrb, struct gc_arena *arena) {
-  mrb_heap_page *heap = arena->gc.heaps;
-  while (heap->next) {
-    heap = heap->next;
+/*
+ * Document-method: GC::Arena#dump
+ *
+ * Saves the Arena's objects and storage to an image file, which can be loaded
+ * by {GC::Arena.load} far faster than the same data could be rebuilt.
+ *
+ * Only plain objects, strings, arrays, hashes, ranges, integers and floats may
+ * be saved, and every object they refer to must live within the Arena. Classes
+ * and symbols are recorded by name; classes must be named, and objects must
+ * not have singleton classes. Strings and arrays sharing their contents are
+ * first given a copy of their own.
+ *
+ * > [!NOTE]
+ * > Images can only be loaded by the same build of DragonRuby that wrote them.
+ * > Range endpoints are saved as-is, and should be numbers. Complex, rational
+ * > and arbitrary-precision numbers can't be saved.
+ *
+ * @example Caching Level Data
+ *   level = $level.eval { build_level }
+ *   $level.dump("level.arena", level)
+ *
+ * @param path [String] The file to write the image to.
+ * @param root [Object] An object in this Arena, returned by {GC::Arena.load}.
+ * @return [nil]
+ */
+mrb_value gc_arena_dump_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  const char *path;
+  mrb_value root;
+  MRB(mrb_get_args)(mrb, "zo", &path, &root);
+
+  if (mrb->allocf_ud == arena) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Cannot dump an Arena from within its own eval.");
+  }
+  if (arena->fallback) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Cannot dump an Arena holding allocations beyond its limits.");
+  }
+  if (mrb_immediate_p(root) || !is_in_arena(arena, mrb_ptr(root))) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "The root object must belong to the Arena.");
   }
 
-  struct gc_arena_page *page = arena->page;
-  struct gc_arena_page *last, *next;
-  while (page->next) {
-    next = page->next;
-    free(page);
-    page = next;
+  struct gc_arena_dump dump = {.arena = arena};
+  gc_arena_eval_func(mrb, arena, gc_arena_dump_objects, &dump);
+
+  for (size_t idx = 0; !dump.error && idx < dump.classes.count; idx++) {
+    struct RClass *cls = (struct RClass *)(uintptr_t)dump.classes.entries[idx].key;
+    const char *name = ((struct RBasic *)cls)->tt == MRB_TT_SCLASS ? NULL : MRB(mrb_class_name)(mrb, cls);
+    if (!name || name[0] == '#') {
+      dump.error = "Arena images cannot contain instances of anonymous or singleton classes.";
+    } else {
+      gc_arena_image_names_set(&dump.classes, idx, name, strlen(name));
+    }
   }
 
-  *heap = (mrb_heap_page){.freelist = gc_arena_initialize_heap(heap, arena->initial_objects)};
+  if (!dump.error && !gc_arena_image_dump(arena, path, mrb_ptr(root), &dump.classes, &dump.symbols, dump.flags)) {
+    dump.error = "Unable to write Arena image.";
+  }
 
-  page->ptr = (void *)(heap + 1) + sizeof(ObjectSlot) * arena->initial_objects;
-  arena->page = page;
-  arena->gc.live = 0;
-  arena->gc.sweeps = NULL;
-  arena->gc.heaps = heap;
-  arena->gc.free_heaps = heap;
+  gc_arena_image_names_free(&dump.classes);
+  gc_arena_image_names_free(&dump.symbols);
+  if (dump.error) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), dump.error);
+  return mrb_nil_value();
 }
 
-struct gc_arena *gc_arena_allocate(mrb_state *mrb, size_t object_count, size_t storage_bytes) {
-  // @NOTE We're allocating a single chunk of memory to house the arena and all
-  //       the anticipated data. This isn't strictly necessary — we could make
-  //       separate allocations — but it simplifies cleanup later.
-  size_t gc_arena_size = 0;
-  gc_arena_size += sizeof(struct gc_arena_page);
-  gc_arena_size += sizeof(struct mrb_heap_page);
-  gc_arena_size += sizeof(ObjectSlot) * object_count;
-  gc_arena_size += storage_bytes;
-  void *ptr = malloc(gc_arena_size);
+// Resolves a class path (e.g. `Foo::Bar`) from the top level, returning NULL if
+// any part of it is undefined.
+static struct RClass *gc_arena_resolve_class(mrb_state *mrb, const char *name, size_t len) {
+  struct RClass *cls = mrb->object_class;
+  const char *end = name + len;
+  while (name < end) {
+    const char *sep = memchr(name, ':', end - name);
+    if (!sep) sep = end;
 
-  // Portion out the allocated memory.
-  struct gc_arena_page *page = ptr;
-  page->end = ptr + gc_arena_size;
-  ptr = page + 1;
+    mrb_value outer = mrb_obj_value(cls);
+    mrb_sym sym = MRB(mrb_intern)(mrb, name, sep - name);
+    if (!MRB(mrb_const_defined)(mrb, outer, sym)) return NULL;
 
-  mrb_heap_page *heap = ptr;
-  ptr += sizeof(struct mrb_heap_page) + sizeof(ObjectSlot) * object_count;
+    mrb_value value = MRB(mrb_const_get)(mrb, outer, sym);
+    if (mrb_type(value) != MRB_TT_CLASS && mrb_type(value) != MRB_TT_MODULE) return NULL;
 
-  // Initialize our values.
-  struct gc_arena *arena = &gc_arenas[gc_arena_count];
-  *page = (struct gc_arena_page){.start = heap + 1, .ptr = ptr, .end = page->end};
-  *heap = (mrb_heap_page){.freelist = gc_arena_initialize_heap(heap, object_count)};
-  *arena = (struct gc_arena){
-    .gc = {
-      .heaps = heap,
-      .free_heaps = heap,
-      .current_white_part = GC_RED,
-      .disabled = TRUE,
-    },
-    .initial_objects = object_count,
-    .beg = page,
-    .end = page->end,
-    .page = page,
-  };
+    cls = mrb_class_ptr(value);
+    name = sep + 2 < end ? sep + 2 : end;
+  }
 
-  gc_arena_count++;
-  return arena;
+  return cls;
 }
 
-mrb_value gc_arena_eval_body(struct mrb_state *mrb, mrb_value data_cptr) {
-  struct gc_arena_eval_cb_data *data = mrb_cptr(data_cptr);
-  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, data->self, &gc_arena_data_type);
+/*
+ * Document-method: GC::Arena.load
+ *
+ * Loads an image written by {GC::Arena#dump} into a new Arena.
+ *
+ * The image is mapped directly into memory, and the pointers within it are
+ * adjusted in a single pass. Classes and symbols are then resolved by name;
+ * if symbols have been assigned different ids since the image was written,
+ * the affected arrays, hashes and instance variables are updated to match.
+ *
+ * The new Arena has no free storage, so any further allocations will add
+ * overflow pages. Savepoints taken before the image was written cannot be
+ * used to rewind the loaded Arena.
+ *
+ * @example Caching Level Data
+ *   if File.exist?("level.arena")
+ *     $level, level = GC::Arena.load("level.arena")
+ *   end
+ *
+ * @param path [String] The image file to load.
+ * @return [Array] The new Arena, and the root object given to {GC::Arena#dump}.
+ */
+mrb_value gc_arena_load_cm(mrb_state *mrb, mrb_value cls) {
+  const char *path;
+  MRB(mrb_get_args)(mrb, "z", &path);
 
-  // Backup mrb_state props.
-  data->original_gc = mrb->gc;
-  data->original_allocf_ud = mrb->allocf_ud;
+  struct gc_arena_image image;
+  if (!gc_arena_image_open(path, &image)) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "Unable to read Arena image.");
+  }
 
-  // Swap in the Arena's GC and allocator.
-  mrb->gc = arena->gc;
-  mrb->gc.arena = data->original_gc.arena;
-  mrb->gc.arena_idx = data->original_gc.arena_idx;
-  mrb->gc.arena_capa = data->original_gc.arena_capa;
-  mrb->allocf_ud = arena;
+  struct gc_arena_image_header *header = image.header;
+  struct gc_arena_load load = {
+    .image = &image,
+    .classes = malloc(sizeof(struct RClass *) * (header->class_count + 1)),
+    .symbols = malloc(sizeof(mrb_sym) * (header->symbol_count + 1)),
+  };
 
-  // Evaluate the block.
-  return MRB(mrb_yield_argv)(mrb, data->block, 0, NULL);
-}
+  for (size_t idx = 0; idx < header->class_count; idx++) {
+    struct gc_arena_image_name *entry = &image.classes[idx];
+    load.classes[idx] = gc_arena_resolve_class(mrb, image.names + entry->offset, entry->len);
+    if (load.classes[idx]) continue;
 
-mrb_value gc_arena_eval_ensure(struct mrb_state *mrb, mrb_value data_cptr) {
-  struct gc_arena_eval_cb_data *data = mrb_cptr(data_cptr);
-  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, data->self, &gc_arena_data_type);
+    char name[256];
+    snprintf(name, sizeof(name), "%.*s", (int)entry->len, image.names + entry->offset);
+    free(load.classes);
+    free(load.symbols);
+    gc_arena_image_close(&image);
+    MRB(mrb_raisef)(mrb, MRB(mrb_class_get)(mrb, "NameError"), "Arena image refers to undefined class %s.", name);
+  }
 
-  // Restore mrb_state props.
-  arena->gc = mrb->gc;
-  mrb->gc = data->original_gc;
-  mrb->allocf_ud = data->original_allocf_ud;
+  mrb_bool remap = header->flags & GC_ARENA_IMAGE_FIXUP_VALUES;
+  for (size_t idx = 0; idx < header->symbol_count; idx++) {
+    struct gc_arena_image_name *entry = &image.symbols[idx];
+    load.symbols[idx] = MRB(mrb_intern)(mrb, image.names + entry->offset, entry->len);
+    if (load.symbols[idx] != entry->key) remap = TRUE;
+  }
 
-  return mrb_nil_value();
-}
+  void *root;
+  struct gc_arena *arena = gc_arena_image_restore(mrb, &image, load.classes, &root);
+  struct RData *obj = gc_arena_data_object_alloc(mrb, mrb_class_ptr(cls), arena, &gc_arena_data_type);
 
-size_t gc_arena_page_available(struct gc_arena_page *page) {
-  return page->end - page->ptr;
+  if (remap) gc_arena_eval_func(mrb, arena, gc_arena_load_objects, &load);
+  free(load.classes);
+  free(load.symbols);
+  free(load.pairs);
+
+  mrb_value result[2] = {mrb_obj_value(obj), mrb_obj_value(root)};
+  return MRB(mrb_ary_new_from_values)(mrb, 2, result);
 }
 
-#pragma endregion
+/*
+ * Document-method: GC::Arena#promote
+ *
+ * Copies an object, and everything it refers to, into this Arena. Objects
+ * referenced more than once are copied once, so shared references and cycles
+ * are preserved. Objects already in this Arena (and classes, symbols and
+ * immediate values) are used as-is.
+ *
+ * Copies keep the class of their original, so objects with singleton classes,
+ * and objects or classes whose class was defined within another Arena, can't
+ * be promoted; that class would be lost when its Arena is reset.
+ *
+ * Each copy is allocated at its final size, so the result is as compact as the
+ * data allows, and the Arena the original was built in can be reset as soon as
+ * this returns.
+ *
+ * Only plain objects, strings, arrays, hashes and numbers can be promoted.
+ *
+ * > [!NOTE]
+ * > Objects are copied without calling `initialize` or `initialize_copy`.
+ * > If the graph can't be promoted, copies made before the problem was found
+ * > remain in the Arena until it is next reset.
+ *
+ * @example Keeping a Computed Result
+ *   navmesh = $scratch.eval { build_navmesh(level) }
+ *   $level.promote(navmesh)
+ *   $scratch.reset
+ *
+ * @param obj [Object] The root of the object graph to copy.
+ * @return [Object] The copy of `obj`.
+ */
+mrb_value gc_arena_promote_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+  mrb_value obj;
+  MRB(mrb_get_args)(mrb, "o", &obj);
 
-#pragma region Ruby Interface
+  struct gc_arena_promote promote = {.arena = arena, .root = obj};
+  mrb_value result;
+  if (mrb->allocf_ud == arena) {
+    result = gc_arena_promote_objects(mrb, &promote);
+  } else {
+    result = gc_arena_eval_func(mrb, arena, gc_arena_promote_objects, &promote);
+  }
+
+  gc_arena_promote_free(&promote);
+  if (promote.error) MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "TypeError"), promote.error);
+  return result;
+}
 
 /*
- * Document-class: GC::Arena
+ * Document-class: GC::Arena::Ring
  *
- * Arena-style memory management in Ruby.
+ * A fixed number of Arena generations, sharing a single allocation, which are
+ * reused in rotation. Data allocated during one generation remains valid until
+ * the Ring has advanced through every other generation.
  */
 
 /*
- * Document-method: GC::Arena.allocate
+ * Document-method: GC::Arena::Ring.allocate
  *
- * Allocates a new `GC::Arena`, reserving a pool of memory for objects and their
- * backing data.
+ * Allocates a new `GC::Arena::Ring`, reserving a pool of memory for each of its
+ * generations.
  *
- * @overload allocate(objects:, storage: 0)
- *   @param objects [Integer] The number of objects to allocate space for.
- *   @param storage [Integer] Additional bytes of storage to allocate.
- #   @return GC::Arena
+ * @example Double Buffering
+ *   $frames = GC::Arena::Ring.allocate(generations: 2, objects: 2048)
+ *   def tick(args)
+ *     $frames.advance
+ *     $frames.eval do
+ *       # The previous frame's data can be read, but not modified.
+ *       args.state.entities = update(args.state.entities)
+ *     end
+ *   end
+ *
+ * @overload allocate(generations: 2, objects:, storage: 0)
+ *   @param generations [Integer] The number of generations to rotate between.
+ *   @param objects [Integer] The number of objects to allocate space for, per generation.
+ *   @param storage [Integer] Additional bytes of storage to allocate, per generation.
+ #   @return GC::Arena::Ring
  */
-mrb_value gc_arena_allocate_cm(mrb_state *mrb, mrb_value cls) {
-  if (is_arena(mrb->allocf_ud)) {
-    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Nested Arenas are not supported.");
-  }
-
-  mrb_value values[2];
+mrb_value gc_arena_ring_allocate_cm(mrb_state *mrb, mrb_value cls) {
+  mrb_value values[3];
   const mrb_kwargs kwargs = {
-    .num = 2,
-    .required = 1,
-    .table = (const mrb_sym[2]){
+    .num = 3,
+    .required = 0,
+    .table = (const mrb_sym[3]){
+      MRB(mrb_intern_static)(mrb, "generations", 11),
       MRB(mrb_intern_static)(mrb, "objects", 7),
       MRB(mrb_intern_static)(mrb, "storage", 7),
     },
     .values = values,
   };
   MRB(mrb_get_args)(mrb, ":", &kwargs);
-  if (mrb_undef_p(values[1])) values[1] = mrb_fixnum_value(0);
-
-  struct gc_arena *arena = gc_arena_allocate(mrb, mrb_fixnum(values[0]), mrb_fixnum(values[1]));
+  if (mrb_undef_p(values[0])) values[0] = mrb_fixnum_value(2);
+  if (mrb_undef_p(values[1])) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "missing keyword: objects");
+  }
+  if (mrb_undef_p(values[2])) values[2] = mrb_fixnum_value(0);
+  if (mrb_fixnum(values[0]) < 2) {
+    MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "ArgumentError"), "generations must be at least 2");
+  }
 
-  struct RData *obj = MRB(mrb_data_object_alloc)(mrb, mrb_class_ptr(cls), arena, &gc_arena_data_type);
+  struct gc_arena_ring *ring = gc_arena_ring_allocate(mrb, mrb_fixnum(values[0]), mrb_fixnum(values[1]), mrb_fixnum(values[2]));
+  struct RData *obj = gc_arena_data_object_alloc(mrb, mrb_class_ptr(cls), ring, &gc_arena_ring_data_type);
   return mrb_obj_value(obj);
 }
 
 /*
- * Document-method: GC::Arena#eval
+ * Document-method: GC::Arena::Ring#eval
  *
- * Substitutes this Arena in place of the current object pool and allocator,
- * forcing object creation within the given block to occur within this Arena.
- *
- * * Nested calls to `GC:::Arena#eval` should function as expected.
- * * Allocations performed by C extensions will also utilize this Arena if they
- *   perform allocations using the mruby provided APIs.
+ * Evaluates the given block within the Ring's current generation, as with
+ * {GC::Arena#eval}.
  *
  * @yield Nothing.
  * @return The block's result.
  */
-mrb_value gc_arena_eval_m(mrb_state *mrb, mrb_value self) {
-  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
+mrb_value gc_arena_ring_eval_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena_ring *ring = MRB(mrb_get_datatype)(mrb, self, &gc_arena_ring_data_type);
   mrb_value block;
   MRB(mrb_get_args)(mrb, "&", &block);
 
-  struct gc_arena_eval_cb_data data = {.self = self, .block = block};
-  mrb_value data_cptr = mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = &data});
-
-  return MRB(mrb_ensure)(mrb, gc_arena_eval_body, data_cptr, gc_arena_eval_ensure, data_cptr);
+  return gc_arena_eval(mrb, ring->generations[ring->current], block);
 }
 
 /*
- * Document-method: GC::Arena#reset
+ * Document-method: GC::Arena::Ring#advance
  *
- * Resets the Arena's allocator.
+ * Rotates the Ring to its next generation, which is reset before use.
  *
  * > [!IMPORTANT]
- * > This will invalidate references to every object in this Arena! It is your
- * > responsibility to ensure that you no longer reference those objects.
- *
- * This enables scratch and periodic Arenas to quickly and quietly discard all
- * data and prepare for further use. Manually resetting is faster than
- * allocating a new Arena, and substantially faster than delegating to the GC.
- *
- * @example Scratch Storage
- *   $scratch = Arena.new(objects: 2048)
- *   def tick(...)
- *     $scratch.reset
- *     $scratch.eval do
- *       simulate_game
- *       render_game
- *     end
- *   end
+ * > This will invalidate references to every object in the oldest generation!
+ * > With `N` generations, objects remain valid for `N - 1` calls to `advance`.
  *
  * @return [nil]
  */
-mrb_value gc_arena_reset_m(mrb_state *mrb, mrb_value self) {
-  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
-  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
-  gc_arena_reset(mrb, arena);
-  if (mrb->allocf_ud == arena) mrb->gc = arena->gc;
+mrb_value gc_arena_ring_advance_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena_ring *ring = MRB(mrb_get_datatype)(mrb, self, &gc_arena_ring_data_type);
+  for (size_t idx = 0; idx < ring->count; idx++) {
+    if (mrb->allocf_ud == ring->generations[idx]) {
+      MRB(mrb_raise)(mrb, MRB(mrb_class_get)(mrb, "RuntimeError"), "Cannot advance a Ring from within its own eval.");
+    }
+  }
+
+  gc_arena_ring_advance(mrb, ring);
   return mrb_nil_value();
 }
 
 /*
- * Document-method: GC::Arena#stats
+ * Document-method: GC::Arena::Ring#stats
  *
- * Provides details about the utilization of this Arena. These details can be
- * used to determine appropriate values for preallocation, by inspecting these
- * values either after the Arena has been fully populated or periodically just
- * before resetting the Arena (to determine a "high water mark" for
- * object/memory consumption).
+ * Provides details about the utilization of each generation in this Ring.
  *
- * @return [Hash] Detailed statistics about this Arena.
- *   * `pages`
- *       * This indicates the number of memory pages that have been allocated
- *         since the Arena was created. Numbers greater than `1` indicate that
- *         usage has exceeded the initialization capacity.
- *   * `total_objects`
- *       * This represents the total number of object slots currently available.
- *   * `live_objects`
- *       * This represents the number of object slots which have been filled since
- *         the Arena was created.
- *   * `free_objects`
- *       * This represents the number of unpopulated object slots.
- *   * `total_storage`
- *       * This represents the total number of bytes allocated for additional
- *         object data storage.
- *   * `used_storage`
- *       * This represents the number of bytes of additional object storage
- *         currently being used.
- *   * `free_storage`
- *       * This represents the number of bytes allocated but as-yet unused.
- *       * Note that this number *may* be higher than expected, as data near the
- *         end of a page may be left indefinitely "free" if the next allocation is
- *         larger than the remaining available space.
+ * @return [Hash] Detailed statistics about this Ring.
+ *   * `current`
+ *       * The index of the current generation.
+ *   * `generations`
+ *       * An Array of statistics for each generation, in the same format as
+ *         {GC::Arena#stats}. The `peak_*` values for each generation represent
+ *         its high-water marks across every frame it has been used for.
  */
-mrb_value gc_arena_stats_m(mrb_state *mrb, mrb_value self) {
-  struct gc_arena *arena = MRB(mrb_get_datatype)(mrb, self, &gc_arena_data_type);
-
-  // Sync GC details if the arena is currently "live".
-  if (mrb->allocf_ud == arena) arena->gc = mrb->gc;
+mrb_value gc_arena_ring_stats_m(mrb_state *mrb, mrb_value self) {
+  struct gc_arena_ring *ring = MRB(mrb_get_datatype)(mrb, self, &gc_arena_ring_data_type);
 
-  struct gc_arena_stats stats;
-  gc_arena_stats(mrb, arena, &stats);
+  mrb_value generations = MRB(mrb_ary_new_capa)(mrb, ring->count);
+  for (size_t idx = 0; idx < ring->count; idx++) {
+    mrb_value hash = gc_arena_stats_hash(mrb, ring->generations[idx], MRB(mrb_hash_new)(mrb));
+    MRB(mrb_ary_push)(mrb, generations, hash);
+  }
 
   mrb_value hash = MRB(mrb_hash_new)(mrb);
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "pages", 5)), mrb_fixnum_value(stats.pages));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "total_objects", 13)), mrb_fixnum_value(stats.total_objects));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "live_objects", 12)), mrb_fixnum_value(stats.live_objects));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "free_objects", 12)), mrb_fixnum_value(stats.free_objects));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "total_storage", 13)), mrb_fixnum_value(stats.total_storage));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "used_storage", 12)), mrb_fixnum_value(stats.used_storage));
-  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "free_storage", 12)), mrb_fixnum_value(stats.free_storage));
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "current", 7)), mrb_fixnum_value(ring->current));
+  MRB(mrb_hash_set)(mrb, hash, mrb_symbol_value(MRB(mrb_intern_static)(mrb, "generations", 11)), generations);
 
   return hash;
 }
 
 void drb_register_c_extensions_with_api(mrb_state *mrb, struct drb_api_t *drb) {
   api = drb;
-  if (fallback_allocf) return;
+  if (mrb->allocf == gc_arena_allocf) return;
 
-  fallback_allocf = mrb->allocf;
+  // Each state gets a registry of its own, so that states running on other
+  // threads never share (or contend for) allocator state.
+  struct gc_arena_registry *registry = calloc(1, sizeof(struct gc_arena_registry));
+  *registry = (struct gc_arena_registry){.registry = registry, .allocf = mrb->allocf, .allocf_ud = mrb->allocf_ud};
   mrb->allocf = gc_arena_allocf;
+  mrb->allocf_ud = registry;
+  gc_arena_intern_stat_keys(mrb, registry);
+  registry->roots = MRB(mrb_ary_new_capa)(mrb, GC_ARENA_MAX_ENTERED);
+  MRB(mrb_ary_set)(mrb, registry->roots, GC_ARENA_MAX_ENTERED - 1, mrb_nil_value());
+  MRB(mrb_gc_register)(mrb, registry->roots);
 
   struct RClass *GC = MRB(mrb_module_get)(mrb, "GC");
   struct RClass *Arena = MRB(mrb_define_class_under)(mrb, GC, "Arena", mrb->object_class);
   MRB_SET_INSTANCE_TT(Arena, MRB_TT_DATA);
 
   MRB(mrb_undef_class_method)(mrb, Arena, "new");
-  MRB(mrb_define_class_method)(mrb, Arena, "allocate", gc_arena_allocate_cm, MRB_ARGS_KEY(2, 1));
+  MRB(mrb_define_class_method)(mrb, Arena, "allocate", gc_arena_allocate_cm, MRB_ARGS_KEY(15, 1));
   MRB(mrb_define_method)(mrb, Arena, "eval", gc_arena_eval_m, MRB_ARGS_BLOCK());
+  MRB(mrb_define_method)(mrb, Arena, "enter", gc_arena_enter_m, MRB_ARGS_NONE());
+  MRB(mrb_define_method)(mrb, Arena, "leave", gc_arena_leave_m, MRB_ARGS_NONE());
+  MRB(mrb_define_method)(mrb, Arena, "eval_each", gc_arena_eval_each_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "array", gc_arena_array_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "hash_with_capacity", gc_arena_hash_with_capacity_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "string", gc_arena_string_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "array_from", gc_arena_array_from_m, MRB_ARGS_REQ(1) | MRB_ARGS_KEY(1, 0));
+  MRB(mrb_define_method)(mrb, Arena, "intern", gc_arena_intern_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_class_method)(mrb, Arena, "outer", gc_arena_outer_cm, MRB_ARGS_BLOCK());
   MRB(mrb_define_method)(mrb, Arena, "reset", gc_arena_reset_m, MRB_ARGS_NONE());
-  MRB(mrb_define_method)(mrb, Arena, "stats", gc_arena_stats_m, MRB_ARGS_NONE());
+  MRB(mrb_define_method)(mrb, Arena, "mark", gc_arena_mark_m, MRB_ARGS_NONE());
+  MRB(mrb_define_method)(mrb, Arena, "rewind", gc_arena_rewind_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "reserve", gc_arena_reserve_m, MRB_ARGS_KEY(2, 0));
+  MRB(mrb_define_method)(mrb, Arena, "stats", gc_arena_stats_m, MRB_ARGS_OPT(1));
+  MRB(mrb_define_method)(mrb, Arena, "stat", gc_arena_stat_m, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "dump", gc_arena_dump_m, MRB_ARGS_REQ(2));
+  MRB(mrb_define_class_method)(mrb, Arena, "load", gc_arena_load_cm, MRB_ARGS_REQ(1));
+  MRB(mrb_define_method)(mrb, Arena, "promote", gc_arena_promote_m, MRB_ARGS_REQ(1));
+#ifdef GC_ARENA_PROFILE
+  MRB(mrb_define_method)(mrb, Arena, "profile", gc_arena_profile_m, MRB_ARGS_NONE());
+#endif
+#ifdef GC_ARENA_TRACE
+  MRB(mrb_define_class_method)(mrb, Arena, "trace", gc_arena_trace_cm, MRB_ARGS_REQ(1));
+#endif
+
+  struct RClass *Ring = MRB(mrb_define_class_under)(mrb, Arena, "Ring", mrb->object_class);
+  MRB_SET_INSTANCE_TT(Ring, MRB_TT_DATA);
+
+  MRB(mrb_undef_class_method)(mrb, Ring, "new");
+  MRB(mrb_define_class_method)(mrb, Ring, "allocate", gc_arena_ring_allocate_cm, MRB_ARGS_KEY(3, 1));
+  MRB(mrb_define_method)(mrb, Ring, "eval", gc_arena_ring_eval_m, MRB_ARGS_BLOCK());
+  MRB(mrb_define_method)(mrb, Ring, "advance", gc_arena_ring_advance_m, MRB_ARGS_NONE());
+  MRB(mrb_define_method)(mrb, Ring, "stats", gc_arena_ring_stats_m, MRB_ARGS_NONE());
+
+  struct RClass *Mark = MRB(mrb_define_class_under)(mrb, Arena, "Mark", mrb->object_class);
+  MRB_SET_INSTANCE_TT(Mark, MRB_TT_DATA);
+  MRB(mrb_undef_class_method)(mrb, Mark, "new");
 
 #if false
   // This pseudo-code exists to document the Ruby API for YARD.
@@ -490,7 +4644,34 @@ void drb_register_c_extensions_with_api(mrb_state *mrb, struct drb_api_t *drb) {
 
   rb_define_singleton_method(Arena, "allocate", gc_arena_allocate_cm, -1);
   rb_define_method(Arena, "eval", gc_arena_eval_m, 0);
+  rb_define_method(Arena, "enter", gc_arena_enter_m, 0);
+  rb_define_method(Arena, "leave", gc_arena_leave_m, 0);
+  rb_define_method(Arena, "eval_each", gc_arena_eval_each_m, 1);
+  rb_define_method(Arena, "array", gc_arena_array_m, 1);
+  rb_define_method(Arena, "hash_with_capacity", gc_arena_hash_with_capacity_m, 1);
+  rb_define_method(Arena, "string", gc_arena_string_m, 1);
+  rb_define_method(Arena, "array_from", gc_arena_array_from_m, -1);
+  rb_define_method(Arena, "intern", gc_arena_intern_m, 1);
+  rb_define_singleton_method(Arena, "outer", gc_arena_outer_cm, 0);
   rb_define_method(Arena, "reset", gc_arena_reset_m, 0);
-  rb_define_method(Arena, "stats", gc_arena_stats_m, 0);
+  rb_define_method(Arena, "mark", gc_arena_mark_m, 0);
+  rb_define_method(Arena, "rewind", gc_arena_rewind_m, 1);
+  rb_define_method(Arena, "reserve", gc_arena_reserve_m, -1);
+  rb_define_method(Arena, "stats", gc_arena_stats_m, -1);
+  rb_define_method(Arena, "stat", gc_arena_stat_m, 1);
+  rb_define_method(Arena, "dump", gc_arena_dump_m, 2);
+  rb_define_singleton_method(Arena, "load", gc_arena_load_cm, 1);
+  rb_define_method(Arena, "promote", gc_arena_promote_m, 1);
+  rb_define_method(Arena, "profile", gc_arena_profile_m, 0);
+  rb_define_singleton_method(Arena, "trace", gc_arena_trace_cm, 1);
+
+  Ring = rb_define_class_under(Arena, "Ring", rb_cObject);
+
+  rb_define_singleton_method(Ring, "allocate", gc_arena_ring_allocate_cm, -1);
+  rb_define_method(Ring, "eval", gc_arena_ring_eval_m, 0);
+  rb_define_method(Ring, "advance", gc_arena_ring_advance_m, 0);
+  rb_define_method(Ring, "stats", gc_arena_ring_stats_m, 0);
+
+  Mark = rb_define_class_under(Arena, "Mark", rb_cObject);
 #endif
 }
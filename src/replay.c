@@ -0,0 +1,288 @@
+#include "gc-arena.c"
+#include "../vendor/utest.h"
+
+// Replays an allocation trace recorded by `GC::Arena.trace` through the Arena
+// allocator, under the given settings, and reports the resulting throughput,
+// peak memory and fragmentation as a single JSON object. Memory counts every
+// byte of storage held by the Arenas (including retained pages); fragmentation
+// is the fraction of peak memory not accounted for by the peak live bytes.
+//
+// Usage: replay [options] TRACE
+//   --storage BYTES         Override the preallocated storage of every Arena.
+//   --page-size BYTES       The size of the first overflow page.
+//   --max-page-size BYTES   The largest page geometric growth will produce.
+//   --growth fixed|geometric
+//   --growth-factor FACTOR
+//   --retain BYTES          Overflow pages to keep across resets.
+//   --coalesce              Merge retained pages into a single page.
+//   --recycle               Reuse storage released by frees.
+
+// This is a reproduction of the mruby default allocf function.
+void *replay_allocf(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  } else {
+    return realloc(ptr, size);
+  }
+}
+static mrb_allocf fallback_allocf = replay_allocf;
+
+// A traced block or savepoint. Serials order allocations, reallocations and
+// marks across the whole trace.
+struct replay_block {
+  void *ptr;
+  uint64_t size;
+  uint32_t arena;
+  uint32_t epoch;
+  uint64_t serial;
+  struct gc_arena_mark *mark;
+  size_t live;
+};
+
+struct replay_arena {
+  struct gc_arena *arena;
+  uint32_t epoch;
+  size_t live;
+  size_t memory;
+};
+
+struct replay_settings {
+  long long storage;
+  struct gc_arena_growth growth;
+  size_t retain;
+  mrb_bool coalesce;
+  mrb_bool recycle;
+};
+
+static struct replay_block *blocks = NULL;
+static size_t blocks_capa = 0;
+static uint64_t serials = 0;
+static struct replay_arena *arenas = NULL;
+static size_t arenas_capa = 0;
+
+#define grow(array, capa, idx) \
+  do { \
+    if ((idx) >= (capa)) { \
+      size_t new_capa = (capa) ? (capa) : 64; \
+      while (new_capa <= (idx)) new_capa *= 2; \
+      (array) = realloc((array), new_capa * sizeof(*(array))); \
+      memset((array) + (capa), 0, (new_capa - (capa)) * sizeof(*(array))); \
+      (capa) = new_capa; \
+    } \
+  } while (0)
+
+static uint64_t decode(const uint8_t *bytes, int count) {
+  uint64_t value = 0;
+  for (int idx = count - 1; idx >= 0; idx--) value = value << 8 | bytes[idx];
+  return value;
+}
+
+// Invalidates the blocks and savepoints an Arena has touched since the given
+// savepoint, as rewinding to it discards them.
+static void invalidate_since(uint32_t arena, uint32_t epoch, uint64_t serial) {
+  for (size_t idx = 0; idx < blocks_capa; idx++) {
+    struct replay_block *block = &blocks[idx];
+    if (block->arena != arena || block->epoch != epoch || block->serial <= serial) continue;
+
+    block->ptr = NULL;
+    free(block->mark);
+    block->mark = NULL;
+  }
+}
+
+static size_t arena_memory(struct gc_arena *arena) {
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  return stats.total_storage + stats.retained_storage;
+}
+
+int main(int argc, const char *argv[]) {
+  struct replay_settings settings = {
+    .storage = -1,
+    .growth = {
+      .mode = GC_ARENA_GROWTH_FIXED,
+      .factor = 2,
+      .page_size = GC_ARENA_PAGE_SIZE,
+      .max_page_size = GC_ARENA_MAX_PAGE_SIZE,
+    },
+  };
+
+  const char *path = NULL;
+  for (int idx = 1; idx < argc; idx++) {
+    const char *arg = argv[idx];
+    const char *value = idx + 1 < argc ? argv[idx + 1] : NULL;
+    if (!strcmp(arg, "--coalesce")) {
+      settings.coalesce = TRUE;
+    } else if (!strcmp(arg, "--recycle")) {
+      settings.recycle = TRUE;
+    } else if (arg[0] == '-' && arg[1] == '-' && !value) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    } else if (!strcmp(arg, "--storage")) {
+      settings.storage = strtoll(argv[++idx], NULL, 10);
+    } else if (!strcmp(arg, "--page-size")) {
+      settings.growth.page_size = strtoull(argv[++idx], NULL, 10);
+    } else if (!strcmp(arg, "--max-page-size")) {
+      settings.growth.max_page_size = strtoull(argv[++idx], NULL, 10);
+    } else if (!strcmp(arg, "--growth")) {
+      settings.growth.mode = !strcmp(argv[++idx], "geometric") ? GC_ARENA_GROWTH_GEOMETRIC : GC_ARENA_GROWTH_FIXED;
+    } else if (!strcmp(arg, "--growth-factor")) {
+      settings.growth.factor = strtod(argv[++idx], NULL);
+    } else if (!strcmp(arg, "--retain")) {
+      settings.retain = strtoull(argv[++idx], NULL, 10);
+    } else {
+      path = arg;
+    }
+  }
+
+  if (settings.growth.max_page_size < settings.growth.page_size) settings.growth.max_page_size = settings.growth.page_size;
+  settings.growth.next_page_size = settings.growth.page_size;
+
+  FILE *file = path ? fopen(path, "rb") : NULL;
+  if (!file) {
+    fprintf(stderr, "Usage: replay [options] TRACE\n");
+    return 1;
+  }
+
+  uint8_t header[8];
+  if (fread(header, 1, 8, file) != 8 || memcmp(header, GC_ARENA_TRACE_MAGIC, 4) || decode(header + 4, 4) != GC_ARENA_TRACE_VERSION) {
+    fprintf(stderr, "%s is not a supported allocation trace\n", path);
+    return 1;
+  }
+
+  size_t records = 0, allocations = 0;
+  size_t live = 0, memory = 0;
+  size_t peak_live = 0, peak_memory = 0;
+  utest_int64_t ns = 0;
+
+  uint8_t bytes[GC_ARENA_TRACE_RECORD_SIZE];
+  while (fread(bytes, 1, GC_ARENA_TRACE_RECORD_SIZE, file) == GC_ARENA_TRACE_RECORD_SIZE) {
+    struct gc_arena_trace_record record = {
+      .op = bytes[0],
+      .arena = decode(bytes + 1, 4),
+      .id = decode(bytes + 5, 4),
+      .size = decode(bytes + 9, 8),
+    };
+    records++;
+
+    grow(arenas, arenas_capa, record.arena);
+    struct replay_arena *replay = &arenas[record.arena];
+    struct gc_arena *arena = replay->arena;
+    if (!arena && record.op != GC_ARENA_TRACE_NEW) continue;
+
+    struct replay_block *block = NULL;
+    if (record.op != GC_ARENA_TRACE_NEW && record.id != UINT32_MAX) {
+      grow(blocks, blocks_capa, record.id);
+      block = &blocks[record.id];
+    }
+
+    // Only blocks allocated since the Arena's last reset are still live.
+    mrb_bool valid = block && block->ptr && block->arena == record.arena && block->epoch == replay->epoch;
+    struct replay_block *rewound = NULL;
+    utest_int64_t start = utest_ns();
+
+    switch (record.op) {
+      case GC_ARENA_TRACE_NEW:
+        arena = gc_arena_allocate(NULL, record.id, settings.storage < 0 ? record.size : settings.storage);
+        arena->growth = settings.growth;
+        arena->retain_bytes = settings.retain;
+        arena->coalesce = settings.coalesce;
+        gc_arena_set_recycle(arena, settings.recycle);
+        *replay = (struct replay_arena){.arena = arena, .epoch = replay->epoch + 1};
+        break;
+
+      case GC_ARENA_TRACE_DESTROY:
+        gc_arena_free(NULL, arena);
+        live -= replay->live;
+        replay->arena = NULL;
+        replay->live = 0;
+        break;
+
+      case GC_ARENA_TRACE_MALLOC:
+        if (!block) break;
+        *block = (struct replay_block){
+          .ptr = gc_arena_allocf(NULL, NULL, record.size, arena),
+          .size = record.size,
+          .arena = record.arena,
+          .epoch = replay->epoch,
+          .serial = ++serials,
+        };
+        replay->live += record.size;
+        live += record.size;
+        allocations++;
+        break;
+
+      case GC_ARENA_TRACE_REALLOC:
+        if (!valid) break;
+        block->ptr = gc_arena_allocf(NULL, block->ptr, record.size, arena);
+        replay->live += record.size - block->size;
+        live += record.size - block->size;
+        block->size = record.size;
+        block->serial = ++serials;
+        allocations++;
+        break;
+
+      case GC_ARENA_TRACE_FREE:
+        if (!valid) break;
+        gc_arena_allocf(NULL, block->ptr, 0, arena);
+        block->ptr = NULL;
+        replay->live -= block->size;
+        live -= block->size;
+        allocations++;
+        break;
+
+      case GC_ARENA_TRACE_RESET:
+        gc_arena_reset(NULL, arena);
+        live -= replay->live;
+        replay->live = 0;
+        replay->epoch++;
+        break;
+
+      case GC_ARENA_TRACE_MARK:
+        if (!block) break;
+        block->mark = block->mark ? block->mark : malloc(sizeof(struct gc_arena_mark));
+        gc_arena_mark(arena, block->mark);
+        block->live = replay->live;
+        block->arena = record.arena;
+        block->epoch = replay->epoch;
+        block->serial = ++serials;
+        break;
+
+      case GC_ARENA_TRACE_REWIND:
+        if (!block || !block->mark || block->arena != record.arena || block->epoch != replay->epoch) break;
+        gc_arena_rewind(arena, block->mark);
+        live -= replay->live - block->live;
+        replay->live = block->live;
+        rewound = block;
+        break;
+
+      default:
+        break;
+    }
+
+    ns += utest_ns() - start;
+    if (rewound) invalidate_since(record.arena, replay->epoch, rewound->serial);
+
+    if (replay->arena) {
+      size_t arena_total = arena_memory(replay->arena);
+      memory += arena_total - replay->memory;
+      replay->memory = arena_total;
+    } else {
+      memory -= replay->memory;
+      replay->memory = 0;
+    }
+
+    if (live > peak_live) peak_live = live;
+    if (memory > peak_memory) peak_memory = memory;
+  }
+
+  fclose(file);
+
+  printf("{\"records\": %zu, \"allocations\": %zu, \"ns\": %lld, ", records, allocations, (long long)ns);
+  printf("\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, ", allocations ? (double)ns / allocations : 0.0, ns ? allocations * 1e9 / ns : 0.0);
+  printf("\"peak_memory\": %zu, \"peak_live\": %zu, ", peak_memory, peak_live);
+  printf("\"fragmentation\": %.4f, ", peak_memory ? 1 - (double)peak_live / peak_memory : 0.0);
+  printf("\"final_memory\": %zu, \"final_live\": %zu}\n", memory, live);
+  return 0;
+}
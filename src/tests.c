@@ -1,4 +1,15 @@
+#include <stdlib.h>
+
+// Counts system allocations made by the Arena, for tests of page reuse.
+static size_t test_mallocs;
+static void *test_malloc(size_t size) {
+  test_mallocs++;
+  return malloc(size);
+}
+
+#define malloc(size) test_malloc(size)
 #include "gc-arena.c"
+#undef malloc
 #include "../vendor/utest.h"
 
 // This is a reproduction of the mruby default allocf function.
@@ -12,6 +23,43 @@ void *test_allocf(struct mrb_state *mrb, void *ptr, size_t size, void *ud) {
 }
 static mrb_allocf fallback_allocf = test_allocf;
 
+// This mimics mruby's object allocation from a GC heap.
+void *take_object(mrb_gc *gc) {
+  mrb_heap_page *heap = gc->free_heaps;
+  struct RCptr *obj = (void *)heap->freelist;
+  heap->freelist = obj->p;
+  if (!heap->freelist) gc->free_heaps = heap->free_next;
+  gc->live++;
+
+  *obj = (struct RCptr){.tt = MRB_TT_OBJECT};
+  return obj;
+}
+
+// Creates an empty temporary file, for tests which write images or traces.
+void temp_path(char path[260]) {
+#ifdef _WIN32
+  char dir[MAX_PATH];
+  GetTempPathA(MAX_PATH, dir);
+  GetTempFileNameA(dir, "gca", 0, path);
+#else
+  const char *dir = getenv("TMPDIR");
+  snprintf(path, 260, "%s/gc-arena-XXXXXX", dir ? dir : "/tmp");
+  close(mkstemp(path));
+#endif
+}
+
+// Simulates mruby adding a heap page once the free heaps are exhausted.
+mrb_heap_page *add_heap(struct gc_arena *arena) {
+  mrb_heap_page *heap = gc_arena_allocf(NULL, NULL, GC_ARENA_HEAP_BYTES, arena);
+  memset(heap, 0, GC_ARENA_HEAP_BYTES);
+  heap->freelist = gc_arena_initialize_heap(heap, GC_ARENA_HEAP_SLOTS);
+  heap->next = arena->gc.heaps;
+  arena->gc.heaps->prev = heap;
+  arena->gc.heaps = heap;
+  arena->gc.free_heaps = heap;
+  return heap;
+}
+
 UTEST(gc_alloc, initialization) {
   struct gc_arena *arena = gc_arena_allocate(NULL, 2, 0);
   ASSERT_TRUE(arena);
@@ -26,6 +74,72 @@ UTEST(gc_alloc, initialization) {
   ASSERT_FALSE(ptr3);
 }
 
+UTEST(gc_alloc, free_recycles_arena_descriptors) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 2, 32);
+  ASSERT_TRUE(is_arena(arena->registry, arena));
+
+  gc_arena_free(NULL, arena);
+  ASSERT_FALSE(is_arena(arena->registry, arena));
+
+  struct gc_arena *recycled = gc_arena_allocate(NULL, 2, 32);
+  ASSERT_EQ(arena, recycled);
+  ASSERT_TRUE(is_arena(recycled->registry, recycled));
+  gc_arena_free(NULL, recycled);
+}
+
+UTEST(gc_alloc, supports_many_simultaneous_arenas) {
+  struct gc_arena *arenas[500];
+  for (int idx = 0; idx < 500; idx++) {
+    arenas[idx] = gc_arena_allocate(NULL, 0, 32);
+    ASSERT_TRUE(is_arena(arenas[idx]->registry, arenas[idx]));
+    strcpy(alloc_with_arena(arenas[idx], 8), "Hello");
+  }
+
+  for (int idx = 0; idx < 500; idx++) {
+    ASSERT_TRUE(is_in_arena(arenas[idx], arenas[idx]->page->last));
+    ASSERT_EQ(0, strcmp(arenas[idx]->page->last, "Hello"));
+    gc_arena_free(NULL, arenas[idx]);
+  }
+}
+
+UTEST(gc_alloc, keeps_each_states_arenas_in_its_own_registry) {
+  struct gc_arena_registry registry_a = {.registry = &registry_a, .allocf = test_allocf};
+  struct gc_arena_registry registry_b = {.registry = &registry_b, .allocf = test_allocf};
+  mrb_state mrb_a = {.allocf = gc_arena_allocf, .allocf_ud = &registry_a};
+  mrb_state mrb_b = {.allocf = gc_arena_allocf, .allocf_ud = &registry_b};
+
+  struct gc_arena *arena_a = gc_arena_allocate(&mrb_a, 0, 32);
+  struct gc_arena *arena_b = gc_arena_allocate(&mrb_b, 0, 32);
+  ASSERT_EQ(&registry_a, arena_a->registry);
+  ASSERT_EQ(&registry_b, arena_b->registry);
+  ASSERT_TRUE(is_arena(&registry_a, arena_a));
+  ASSERT_FALSE(is_arena(&registry_a, arena_b));
+  ASSERT_EQ(1, registry_a.range_count);
+  ASSERT_EQ(1, registry_b.range_count);
+
+  // Allocations follow whichever Arena is active, and fall back to the state's
+  // own allocator otherwise.
+  void *ptr_a = gc_arena_allocf(&mrb_a, NULL, 8, arena_a);
+  void *ptr_b = gc_arena_allocf(&mrb_b, NULL, 8, &registry_b);
+  ASSERT_TRUE(is_in_arena(arena_a, ptr_a));
+  ASSERT_FALSE(gc_arena_index_find(&registry_b, ptr_a));
+  ASSERT_FALSE(gc_arena_index_find(&registry_b, ptr_b));
+  gc_arena_allocf(&mrb_b, ptr_b, 0, &registry_b);
+
+  mrb_a.allocf_ud = arena_a;
+  ASSERT_EQ(arena_a, gc_arena_active(&mrb_a));
+  ASSERT_EQ(NULL, gc_arena_active(&mrb_b));
+
+  gc_arena_free(&mrb_a, arena_a);
+  gc_arena_free(&mrb_b, arena_b);
+  ASSERT_EQ(0, registry_a.range_count);
+  ASSERT_EQ(&registry_a, registry_a.free_list->registry);
+  free(registry_a.blocks[0]);
+  free(registry_b.blocks[0]);
+  free(registry_a.ranges);
+  free(registry_b.ranges);
+}
+
 UTEST(alloc_with_arena, basic_alloc) {
   struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
 
@@ -73,6 +187,23 @@ UTEST(alloc_with_arena, multiple_allocations_on_multiple_pages) {
   ASSERT_NE(24, ptr2 - ptr1);
 }
 
+UTEST(alloc_with_arena, counts_size_tags_and_padding) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 256);
+  alloc_with_arena(arena, 4);
+  void *ptr = alloc_with_arena(arena, 16);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(16, stats.header_storage);
+  ASSERT_EQ(4, stats.padding_storage);
+
+  // Extending the most recent block in place updates its padding.
+  ASSERT_EQ(ptr, gc_arena_allocf(NULL, ptr, 20, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(8, stats.padding_storage);
+  gc_arena_free(NULL, arena);
+}
+
 UTEST(gc_arena_allocf, alloc_without_arena) {
   struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
 
@@ -268,6 +399,233 @@ UTEST(gc_arena_allocf, realloc_without_arena_will_identify_correct_arena) {
   ASSERT_EQ(0, gc_arena_page_available(arena->page));
 }
 
+UTEST(gc_arena_allocf, realloc_will_identify_correct_page_across_many_pages) {
+  struct gc_arena *arena_a = gc_arena_allocate(NULL, 0, 32);
+  struct gc_arena *arena_b = gc_arena_allocate(NULL, 0, 32);
+
+  void *ptrs[64];
+  for (int idx = 0; idx < 64; idx++) {
+    struct gc_arena *arena = idx % 2 ? arena_b : arena_a;
+    ptrs[idx] = gc_arena_allocf(NULL, NULL, 8, arena);
+    add_page(arena, 8);
+  }
+
+  for (int idx = 0; idx < 64; idx++) {
+    struct gc_arena *owner = idx % 2 ? arena_b : arena_a;
+    struct gc_arena *other = idx % 2 ? arena_a : arena_b;
+    ASSERT_TRUE(is_in_arena(owner, ptrs[idx]));
+    ASSERT_FALSE(is_in_arena(other, ptrs[idx]));
+  }
+
+  gc_arena_reset(NULL, arena_a);
+  ASSERT_FALSE(is_in_arena(arena_a, ptrs[62]));
+  ASSERT_TRUE(is_in_arena(arena_b, ptrs[63]));
+}
+
+UTEST(add_page, fixed_growth_adds_page_size_to_each_request) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 0);
+  arena->growth.page_size = 64;
+
+  add_page(arena, 16);
+  ASSERT_EQ(80, gc_arena_page_available(arena->page));
+
+  add_page(arena, 16);
+  ASSERT_EQ(80, gc_arena_page_available(arena->page));
+}
+
+UTEST(add_page, geometric_growth_multiplies_page_sizes_up_to_the_maximum) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 0);
+  arena->growth = (struct gc_arena_growth){
+    .mode = GC_ARENA_GROWTH_GEOMETRIC,
+    .factor = 2,
+    .page_size = 64,
+    .max_page_size = 256,
+    .next_page_size = 64,
+  };
+
+  add_page(arena, 16);
+  ASSERT_EQ(64, gc_arena_page_available(arena->page));
+  add_page(arena, 16);
+  ASSERT_EQ(128, gc_arena_page_available(arena->page));
+  add_page(arena, 16);
+  ASSERT_EQ(256, gc_arena_page_available(arena->page));
+  add_page(arena, 16);
+  ASSERT_EQ(256, gc_arena_page_available(arena->page));
+
+  // Requests larger than the next page still fit.
+  add_page(arena, 512);
+  ASSERT_EQ(512 + 64, gc_arena_page_available(arena->page));
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(6, stats.pages);
+  ASSERT_EQ((64 + 128 + 256 + 256 + 576) / 5, stats.average_page_size);
+}
+
+UTEST(gc_arena_allocf, size_classes_cover_requested_sizes) {
+  ASSERT_EQ(0, gc_arena_size_class(1));
+  ASSERT_EQ(0, gc_arena_size_class(8));
+  ASSERT_EQ(1, gc_arena_size_class(9));
+  ASSERT_EQ(31, gc_arena_size_class(256));
+  ASSERT_EQ(320, gc_arena_class_size(gc_arena_size_class(257)));
+  ASSERT_EQ(512, gc_arena_class_size(gc_arena_size_class(512)));
+  ASSERT_EQ(640, gc_arena_class_size(gc_arena_size_class(513)));
+  ASSERT_EQ(GC_ARENA_SIZE_CLASSES - 1, gc_arena_size_class(GC_ARENA_MAX_RECYCLED));
+  ASSERT_EQ(GC_ARENA_MAX_RECYCLED, gc_arena_class_size(GC_ARENA_SIZE_CLASSES - 1));
+  ASSERT_EQ(-1, gc_arena_size_class(GC_ARENA_MAX_RECYCLED + 1));
+
+  for (size_t size = 1; size <= GC_ARENA_MAX_RECYCLED; size += 7) {
+    ASSERT_GE(gc_arena_class_size(gc_arena_size_class(size)), size);
+  }
+}
+
+UTEST(gc_arena_allocf, free_without_recycling_abandons_storage) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 64);
+
+  void *ptr1 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, ptr1, 0, arena);
+
+  void *ptr2 = gc_arena_allocf(NULL, NULL, 8, arena);
+  ASSERT_NE(ptr1, ptr2);
+}
+
+UTEST(gc_arena_allocf, free_with_recycling_reuses_storage) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 256);
+  gc_arena_set_recycle(arena, TRUE);
+
+  void *ptr1 = gc_arena_allocf(NULL, NULL, 24, arena);
+  void *ptr2 = gc_arena_allocf(NULL, NULL, 24, arena);
+  gc_arena_allocf(NULL, ptr1, 0, arena);
+
+  // Blocks are reused by requests of the same size class.
+  ASSERT_NE(ptr1, gc_arena_allocf(NULL, NULL, 32, arena));
+  ASSERT_EQ(ptr1, gc_arena_allocf(NULL, NULL, 20, arena));
+  ASSERT_NE(ptr2, gc_arena_allocf(NULL, NULL, 24, arena));
+
+  gc_arena_set_recycle(arena, FALSE);
+}
+
+UTEST(gc_arena_allocf, realloc_with_recycling_reuses_abandoned_storage) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 256);
+  gc_arena_set_recycle(arena, TRUE);
+
+  void *ptr1 = gc_arena_allocf(NULL, NULL, 10, arena);
+  strcpy(ptr1, "Hello");
+
+  // Growing within the size class happens in place.
+  ASSERT_EQ(ptr1, gc_arena_allocf(NULL, ptr1, 16, arena));
+
+  void *ptr2 = gc_arena_allocf(NULL, NULL, 16, arena);
+  void *ptr3 = gc_arena_allocf(NULL, ptr1, 64, arena);
+  ASSERT_NE(ptr1, ptr3);
+  ASSERT_EQ(0, strcmp(ptr3, "Hello"));
+
+  // The abandoned block is available for reuse.
+  ASSERT_EQ(ptr1, gc_arena_allocf(NULL, NULL, 12, arena));
+
+  // Reset discards the free lists, and the runs.
+  gc_arena_allocf(NULL, ptr2, 0, arena);
+  gc_arena_reset(NULL, arena);
+  void *ptr4 = gc_arena_allocf(NULL, NULL, 16, arena);
+  ASSERT_EQ(arena->runs[1]->start, ptr4);
+
+  gc_arena_set_recycle(arena, FALSE);
+}
+
+UTEST(gc_arena_allocf, recycling_serves_small_blocks_from_untagged_runs) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 256);
+  gc_arena_set_recycle(arena, TRUE);
+
+  // Blocks of a small size class are packed into a run without size tags.
+  char *ptr1 = gc_arena_allocf(NULL, NULL, 20, arena);
+  char *ptr2 = gc_arena_allocf(NULL, NULL, 24, arena);
+  ASSERT_EQ(24, ptr2 - ptr1);
+  ASSERT_EQ(24, arena->runs[2]->run_size);
+  ASSERT_EQ(arena->runs[2], is_in_arena(arena, ptr1));
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.header_storage);
+  ASSERT_EQ(4, stats.padding_storage);
+
+  // Runs record the size for the allocator, which can resize and free them.
+  strcpy(ptr1, "Hello");
+  ASSERT_EQ(ptr1, gc_arena_allocf(NULL, ptr1, 24, arena));
+  char *ptr3 = gc_arena_allocf(NULL, ptr1, 300, arena);
+  ASSERT_EQ(0, strcmp(ptr3, "Hello"));
+  ASSERT_EQ(300, ((uint64_t *)ptr3)[-1]);
+  ASSERT_EQ(ptr1, gc_arena_allocf(NULL, NULL, 17, arena));
+
+  gc_arena_allocf(NULL, ptr2, 0, arena);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.abandoned_storage + stats.freed_storage);
+  ASSERT_EQ(ptr2, gc_arena_allocf(NULL, NULL, 24, arena));
+
+  // Runs are rolled back along with the rest of the Arena.
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  gc_arena_allocf(NULL, NULL, 100, arena);
+  ASSERT_NE(mark.run_page, arena->run_page);
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(mark.run_page, arena->run_page);
+
+  gc_arena_set_recycle(arena, FALSE);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(alloc_aligned, aligns_blocks_and_counts_padding) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 256);
+  alloc_with_arena(arena, 4);
+
+  void *ptr = alloc_aligned(arena, 32, 64);
+  ASSERT_EQ(0, (uintptr_t)ptr % 64);
+  ASSERT_EQ(32, ((uint64_t *)ptr)[-1]);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  size_t gap = ptr - 8 - (arena->page->start + 16);
+  ASSERT_EQ(16, stats.header_storage);
+  ASSERT_EQ(4 + gap, stats.padding_storage);
+
+  // The most recent aligned block can still be extended in place.
+  ASSERT_EQ(ptr, gc_arena_allocf(NULL, ptr, 44, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(4 + gap + 4, stats.padding_storage);
+
+  // Blocks that don't fit move to a new page, keeping their alignment.
+  void *moved = alloc_aligned(arena, 200, 128);
+  ASSERT_EQ(0, (uintptr_t)moved % 128);
+  ASSERT_EQ(arena->page, is_in_arena(arena, moved));
+  ASSERT_LE(moved + 200, arena->page->end);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(alloc_aligned, blocks_are_recycled_by_the_allocator) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 4096);
+  gc_arena_set_recycle(arena, TRUE);
+
+  // Aligned blocks fill their size class, so they can be reused once freed.
+  void *ptr = alloc_aligned(arena, 300, 32);
+  ASSERT_EQ(0, (uintptr_t)ptr % 32);
+  ASSERT_EQ(ptr + gc_arena_block_capa(300), arena->page->ptr);
+  gc_arena_allocf(NULL, ptr, 0, arena);
+  ASSERT_EQ(ptr, gc_arena_allocf(NULL, NULL, 310, arena));
+  ASSERT_EQ(310, ((uint64_t *)ptr)[-1]);
+
+  // Small aligned blocks are tagged, so they're never mistaken for run blocks.
+  void *small = alloc_aligned(arena, 24, 64);
+  ASSERT_EQ(0, (uintptr_t)small % 64);
+  gc_arena_allocf(NULL, small, 0, arena);
+  ASSERT_NE(small, gc_arena_allocf(NULL, NULL, 24, arena));
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(32, stats.freed_storage);
+
+  gc_arena_set_recycle(arena, FALSE);
+  gc_arena_free(NULL, arena);
+}
+
 UTEST(gc_arena_reset, alloc_yields_old_pointers_after_reset) {
   struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
 
@@ -324,6 +682,1125 @@ UTEST(gc_arena_reset, alloc_yields_old_pointers_after_reset_with_prealloc_object
   ASSERT_EQ(0, strcmp(new_ptr2, "Goodbye"));
 }
 
+UTEST(gc_arena_reset, frees_overflow_pages_by_default) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
+
+  void *ptr = alloc_with_arena(arena, 64);
+  ASSERT_TRUE(arena->page->next);
+
+  gc_arena_reset(NULL, arena);
+  ASSERT_FALSE(arena->page->next);
+  ASSERT_FALSE(arena->spare);
+  ASSERT_FALSE(is_in_arena(arena, ptr));
+}
+
+UTEST(gc_arena_reset, retains_overflow_pages_within_budget) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
+  arena->growth.page_size = 64;
+  arena->retain_bytes = 272;
+
+  // Each allocation requires a new 136 byte page.
+  alloc_with_arena(arena, 64);
+  alloc_with_arena(arena, 64);
+  struct gc_arena_page *page2 = arena->page;
+  alloc_with_arena(arena, 64);
+  struct gc_arena_page *page3 = arena->page;
+  ASSERT_NE(page2, page3);
+
+  gc_arena_reset(NULL, arena);
+  ASSERT_FALSE(arena->page->next);
+  ASSERT_EQ(page2, arena->spare);
+  ASSERT_EQ(page3, arena->spare->next);
+  ASSERT_FALSE(arena->spare->next->next);
+  ASSERT_EQ(272, arena->spare_bytes);
+
+  // Retained pages are reused before allocating new ones.
+  void *ptr = alloc_with_arena(arena, 64);
+  ASSERT_EQ(page2, arena->page);
+  ASSERT_EQ(page2->start + 8, ptr);
+  ASSERT_TRUE(is_in_arena(arena, ptr));
+  ASSERT_EQ(page3, arena->spare);
+  ASSERT_EQ(136, arena->spare_bytes);
+}
+
+UTEST(gc_arena_reset, coalesces_retained_pages_into_one) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 32);
+  arena->growth.page_size = 64;
+  arena->retain_bytes = 4096;
+  arena->coalesce = TRUE;
+
+  for (int idx = 0; idx < 8; idx++) alloc_with_arena(arena, 64);
+
+  gc_arena_reset(NULL, arena);
+  struct gc_arena_page *spare = arena->spare;
+  ASSERT_TRUE(spare);
+  ASSERT_FALSE(spare->next);
+  ASSERT_EQ(8 * 72 + 64, page_capa(spare));
+
+  // Steady state: the same workload fits in the coalesced page, and no new
+  // pages are allocated across resets.
+  for (int frame = 0; frame < 3; frame++) {
+    for (int idx = 0; idx < 8; idx++) alloc_with_arena(arena, 64);
+    ASSERT_EQ(spare, arena->page);
+    ASSERT_FALSE(arena->page->next->next);
+
+    gc_arena_reset(NULL, arena);
+    ASSERT_EQ(spare, arena->spare);
+    ASSERT_FALSE(arena->spare->next);
+  }
+}
+
+UTEST(gc_arena_reset, coalesces_object_pages_apart_from_storage) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 32);
+  arena->growth.page_size = 64;
+  arena->object_growth.page_size = GC_ARENA_CHUNK_BYTES;
+  arena->retain_bytes = 8 * GC_ARENA_CHUNK_BYTES;
+  arena->coalesce = TRUE;
+
+  for (int frame = 0; frame < 4; frame++) {
+    size_t mallocs = test_mallocs;
+    for (int idx = 0; idx < 8; idx++) alloc_with_arena(arena, 64);
+    for (int idx = 0; idx < 3; idx++) add_heap(arena);
+    gc_arena_reset(NULL, arena);
+
+    // Once warmed up, each frame reuses the coalesced pages.
+    if (frame > 0) ASSERT_EQ(mallocs, test_mallocs);
+  }
+
+  ASSERT_TRUE(arena->spare);
+  ASSERT_FALSE(arena->spare->next);
+  ASSERT_EQ(8 * 72 + 64, page_capa(arena->spare));
+  ASSERT_TRUE(arena->object_spare);
+  ASSERT_FALSE(arena->object_spare->next);
+  ASSERT_EQ(3 * GC_ARENA_CHUNK_BYTES, page_capa(arena->object_spare));
+  ASSERT_EQ(8 * 72 + 64 + 3 * GC_ARENA_CHUNK_BYTES, arena->spare_bytes);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_allocate_vm, grows_in_place_within_reservation) {
+  struct gc_arena *arena = gc_arena_allocate_vm(NULL, 0, 32, 64 * 1024 * 1024, FALSE);
+  ASSERT_TRUE(arena);
+  struct gc_arena_page *page = arena->page;
+  ASSERT_EQ(GC_ARENA_VM_CHUNK, page->end - (void *)page);
+
+  // Allocations beyond the committed memory commit more of the reservation.
+  void *first = alloc_with_arena(arena, 1024);
+  void *second = alloc_with_arena(arena, 3 * 1024 * 1024);
+  ASSERT_EQ(page, arena->page);
+  ASSERT_FALSE(page->next);
+  ASSERT_EQ(first + 1024 + 8, second);
+  ASSERT_EQ(2 * GC_ARENA_VM_CHUNK, page->end - (void *)page);
+  memset(second, 0xFF, 3 * 1024 * 1024);
+
+  // Trailing allocations can be reallocated in place across the reservation.
+  void *grown = gc_arena_allocf(NULL, second, 8 * 1024 * 1024, arena);
+  ASSERT_EQ(second, grown);
+  ASSERT_TRUE(is_in_arena(arena, grown + 8 * 1024 * 1024 - 1));
+
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_allocate_vm, adds_pages_once_reservation_is_exhausted) {
+  struct gc_arena *arena = gc_arena_allocate_vm(NULL, 0, 32, 0, FALSE);
+  ASSERT_TRUE(arena);
+  struct gc_arena_page *page = arena->page;
+  ASSERT_EQ(page->limit, page->end);
+
+  alloc_with_arena(arena, GC_ARENA_VM_CHUNK);
+  ASSERT_NE(page, arena->page);
+  ASSERT_EQ(page, arena->page->next);
+  ASSERT_FALSE(arena->page->limit);
+
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_allocate_vm, reset_keeps_memory_committed) {
+  struct gc_arena *arena = gc_arena_allocate_vm(NULL, 0, 32, 64 * 1024 * 1024, TRUE);
+  ASSERT_TRUE(arena);
+  ASSERT_EQ(0, (uintptr_t)arena->page % GC_ARENA_VM_CHUNK);
+
+  void *ptr = alloc_with_arena(arena, 4 * 1024 * 1024);
+  void *end = arena->page->end;
+  gc_arena_reset(NULL, arena);
+  ASSERT_EQ(end, arena->page->end);
+  ASSERT_EQ(ptr, alloc_with_arena(arena, 4 * 1024 * 1024));
+  memset(ptr, 0, 4 * 1024 * 1024);
+
+  struct gc_arena_stats stats = {0};
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(64 * 1024 * 1024 - sizeof(struct gc_arena_page) - sizeof(struct mrb_heap_page), stats.reserved_storage);
+
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_rewind, restores_storage_and_releases_later_pages) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 64);
+
+  void *ptr1 = alloc_with_arena(arena, 8);
+  strcpy(ptr1, "Hello");
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  struct gc_arena_page *page = arena->page;
+
+  void *ptr2 = alloc_with_arena(arena, 8);
+  alloc_with_arena(arena, 64);
+  ASSERT_NE(page, arena->page);
+
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(page, arena->page);
+  ASSERT_EQ(48, gc_arena_page_available(arena->page));
+  ASSERT_EQ(0, strcmp(ptr1, "Hello"));
+
+  // Storage is handed out again from the mark.
+  ASSERT_EQ(ptr2, alloc_with_arena(arena, 8));
+}
+
+UTEST(gc_arena_rewind, restores_object_slots) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+
+  void *obj1 = take_object(&arena->gc);
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+
+  void *obj2 = take_object(&arena->gc);
+  for (int idx = 0; idx < 6; idx++) take_object(&arena->gc);
+  ASSERT_EQ(8, arena->gc.live);
+  ASSERT_FALSE(arena->gc.free_heaps);
+
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(1, arena->gc.live);
+  ASSERT_TRUE(arena->gc.free_heaps);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(8, stats.total_objects);
+  ASSERT_EQ(7, stats.free_objects);
+
+  ASSERT_EQ(obj2, take_object(&arena->gc));
+  ASSERT_NE(obj1, take_object(&arena->gc));
+}
+
+UTEST(gc_arena_rewind, can_rewind_repeatedly) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 64);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+
+  for (int frame = 0; frame < 4; frame++) {
+    take_object(&arena->gc);
+    take_object(&arena->gc);
+    alloc_with_arena(arena, 8);
+
+    gc_arena_rewind(arena, &mark);
+    ASSERT_EQ(0, arena->gc.live);
+    ASSERT_EQ(64, gc_arena_page_available(arena->page));
+  }
+}
+
+UTEST(gc_arena_savepoint, survives_marks_that_spill_onto_new_pages) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 64);
+  alloc_with_arena(arena, 56);
+  ASSERT_EQ(0, gc_arena_page_available(arena->page));
+
+  struct gc_arena_page *page = arena->page;
+  struct gc_arena_savepoint *savepoint = gc_arena_savepoint_new(arena);
+  ASSERT_FALSE(is_in_arena(arena, savepoint));
+
+  alloc_with_arena(arena, 64);
+  ASSERT_NE(page, arena->page);
+
+  ASSERT_TRUE(gc_arena_savepoint_rewind(arena, savepoint));
+  ASSERT_EQ(page, arena->page);
+  ASSERT_EQ(0, gc_arena_page_available(arena->page));
+
+  gc_arena_savepoint_free(NULL, savepoint);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_savepoint, are_invalidated_by_reset) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 64);
+  struct gc_arena *other = gc_arena_allocate(NULL, 8, 64);
+
+  struct gc_arena_savepoint *savepoint = gc_arena_savepoint_new(arena);
+  alloc_with_arena(arena, 8);
+  ASSERT_FALSE(gc_arena_savepoint_rewind(other, savepoint));
+
+  gc_arena_reset(NULL, arena);
+  ASSERT_FALSE(gc_arena_savepoint_rewind(arena, savepoint));
+  ASSERT_FALSE(arena->savepoints);
+
+  gc_arena_savepoint_free(NULL, savepoint);
+  gc_arena_free(NULL, other);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_savepoint, rewinding_invalidates_later_savepoints) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 64);
+
+  struct gc_arena_savepoint *first = gc_arena_savepoint_new(arena);
+  alloc_with_arena(arena, 8);
+  struct gc_arena_savepoint *second = gc_arena_savepoint_new(arena);
+  alloc_with_arena(arena, 8);
+
+  ASSERT_TRUE(gc_arena_savepoint_rewind(arena, first));
+  ASSERT_FALSE(gc_arena_savepoint_rewind(arena, second));
+  ASSERT_EQ(64, gc_arena_page_available(arena->page));
+
+  // Earlier savepoints remain valid, and freed savepoints are unlinked.
+  struct gc_arena_savepoint *third = gc_arena_savepoint_new(arena);
+  gc_arena_savepoint_free(NULL, second);
+  gc_arena_savepoint_free(NULL, first);
+  ASSERT_EQ(third, arena->savepoints);
+  ASSERT_FALSE(third->older);
+
+  alloc_with_arena(arena, 8);
+  ASSERT_TRUE(gc_arena_savepoint_rewind(arena, third));
+  ASSERT_EQ(64, gc_arena_page_available(arena->page));
+
+  gc_arena_free(NULL, arena);
+  ASSERT_FALSE(third->arena);
+  gc_arena_savepoint_free(NULL, third);
+}
+
+UTEST(gc_arena_reserve, threads_object_slots_and_storage_up_front) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+  gc_arena_reserve(arena, 1500, 4096);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(2, stats.pages);
+  ASSERT_EQ(8 + 2 * GC_ARENA_HEAP_SLOTS, stats.total_objects);
+
+  // Every reserved slot is available without mruby adding a heap page.
+  for (int idx = 0; idx < 8 + 2 * GC_ARENA_HEAP_SLOTS; idx++) {
+    ASSERT_TRUE(arena->gc.free_heaps);
+    take_object(&arena->gc);
+  }
+  ASSERT_FALSE(arena->gc.free_heaps);
+
+  alloc_with_arena(arena, 4096 - 8);
+  ASSERT_EQ(2, arena->counters.pages);
+
+  gc_arena_reset(NULL, arena);
+  ASSERT_EQ(8, arena->counters.objects);
+  ASSERT_EQ(arena->heap, arena->heaps_tail);
+  ASSERT_FALSE(arena->gc.heaps->next);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_reserve, rewind_restores_reserved_heaps) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+  gc_arena_reserve(arena, 2 * GC_ARENA_HEAP_SLOTS, 0);
+  mrb_heap_page *first = arena->heap->next;
+  mrb_heap_page *second = first->next;
+
+  for (int idx = 0; idx < 4; idx++) take_object(&arena->gc);
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+
+  for (int idx = 0; idx < 4 + GC_ARENA_HEAP_SLOTS + 10; idx++) take_object(&arena->gc);
+  ASSERT_EQ(second, arena->gc.free_heaps);
+
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(4, arena->gc.live);
+  ASSERT_EQ(arena->heap, arena->gc.free_heaps);
+  ASSERT_EQ(first, arena->heap->free_next);
+  ASSERT_EQ(second, first->free_next);
+  ASSERT_FALSE(second->free_next);
+
+  // Heap pages reserved after the mark are dropped.
+  gc_arena_reserve(arena, 1, 0);
+  ASSERT_NE(second, arena->heaps_tail);
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(second, arena->heaps_tail);
+  ASSERT_FALSE(second->next);
+
+  for (int idx = 0; idx < 4 + 2 * GC_ARENA_HEAP_SLOTS; idx++) {
+    ASSERT_TRUE(arena->gc.free_heaps);
+    take_object(&arena->gc);
+  }
+  ASSERT_FALSE(arena->gc.free_heaps);
+  gc_arena_free(NULL, arena);
+}
+
+static mrb_value eval_nothing(mrb_state *mrb, void *data) {
+  return mrb_nil_value();
+}
+
+#define eval_cptr(data) mrb_obj_value(&(struct RCptr){.tt = MRB_TT_CPTR, .p = (data)})
+
+UTEST(gc_arena_eval, nested_evals_park_and_restore_each_context) {
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry, .gc = {.live = 7, .arena_idx = 3}};
+  struct gc_arena *outer = gc_arena_allocate(&mrb, 8, 0);
+  struct gc_arena *inner = gc_arena_allocate(&mrb, 8, 0);
+
+  struct gc_arena_eval_cb_data a = {.arena = outer, .func = eval_nothing};
+  gc_arena_eval_body(&mrb, eval_cptr(&a));
+  ASSERT_EQ(outer, mrb.allocf_ud);
+  take_object(&mrb.gc);
+  take_object(&mrb.gc);
+
+  struct gc_arena_eval_cb_data b = {.arena = inner, .func = eval_nothing};
+  gc_arena_eval_body(&mrb, eval_cptr(&b));
+  ASSERT_EQ(inner, mrb.allocf_ud);
+  ASSERT_EQ(2, outer->gc.live);
+  ASSERT_EQ(0, mrb.gc.live);
+  ASSERT_EQ(3, mrb.gc.arena_idx);
+  take_object(&mrb.gc);
+
+  // The outer Arena may be reset while parked.
+  gc_arena_reset(&mrb, outer);
+  ASSERT_EQ(0, outer->gc.live);
+
+  gc_arena_eval_ensure(&mrb, eval_cptr(&b));
+  ASSERT_EQ(outer, mrb.allocf_ud);
+  ASSERT_EQ(1, inner->gc.live);
+  ASSERT_EQ(0, mrb.gc.live);
+
+  gc_arena_eval_ensure(&mrb, eval_cptr(&a));
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+  ASSERT_EQ(7, mrb.gc.live);
+  ASSERT_FALSE(registry.evals);
+
+  gc_arena_free(&mrb, outer);
+  gc_arena_free(&mrb, inner);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_eval, tracks_the_parent_of_each_eval) {
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *level = gc_arena_allocate(&mrb, 8, 0);
+  struct gc_arena *scratch = gc_arena_allocate(&mrb, 8, 0);
+
+  struct gc_arena_eval_cb_data a = {.arena = level, .func = eval_nothing};
+  struct gc_arena_eval_cb_data b = {.arena = scratch, .func = eval_nothing};
+  struct gc_arena_eval_cb_data c = {.arena = scratch, .func = eval_nothing};
+  gc_arena_eval_body(&mrb, eval_cptr(&a));
+  gc_arena_eval_body(&mrb, eval_cptr(&b));
+  gc_arena_eval_body(&mrb, eval_cptr(&c));
+  ASSERT_EQ(&registry, a.parent);
+  ASSERT_EQ(level, b.parent);
+
+  // Re-entering the current Arena keeps its parent.
+  ASSERT_EQ(level, c.parent);
+  ASSERT_EQ(&c, registry.evals);
+  ASSERT_EQ(&b, c.prev);
+
+  gc_arena_eval_ensure(&mrb, eval_cptr(&c));
+  gc_arena_eval_ensure(&mrb, eval_cptr(&b));
+  gc_arena_eval_ensure(&mrb, eval_cptr(&a));
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+
+  gc_arena_free(&mrb, level);
+  gc_arena_free(&mrb, scratch);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_eval, enter_and_leave_switch_without_a_block) {
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry, .gc = {.live = 7}};
+  struct gc_arena *a = gc_arena_allocate(&mrb, 8, 0);
+  struct gc_arena *b = gc_arena_allocate(&mrb, 8, 0);
+
+  ASSERT_TRUE(gc_arena_enter(&mrb, a, mrb_nil_value()));
+  take_object(&mrb.gc);
+  ASSERT_TRUE(gc_arena_enter(&mrb, b, mrb_nil_value()));
+  ASSERT_EQ(b, mrb.allocf_ud);
+  ASSERT_EQ(1, a->gc.live);
+  ASSERT_EQ(0, mrb.gc.live);
+
+  // Only the innermost entered Arena may be left.
+  ASSERT_FALSE(gc_arena_leave(&mrb, a));
+  ASSERT_TRUE(gc_arena_leave(&mrb, b));
+  ASSERT_EQ(1, mrb.gc.live);
+  ASSERT_TRUE(gc_arena_leave(&mrb, a));
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+  ASSERT_EQ(7, mrb.gc.live);
+  ASSERT_FALSE(gc_arena_leave(&mrb, a));
+
+  // Evals unwind any Arenas entered within them.
+  struct gc_arena_eval_cb_data eval = {.arena = a, .func = eval_nothing};
+  gc_arena_eval_body(&mrb, eval_cptr(&eval));
+  ASSERT_TRUE(gc_arena_enter(&mrb, b, mrb_nil_value()));
+  gc_arena_eval_ensure(&mrb, eval_cptr(&eval));
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+  ASSERT_EQ(0, registry.entered_count);
+  ASSERT_FALSE(registry.evals);
+
+  for (int idx = 0; idx < GC_ARENA_MAX_ENTERED; idx++) ASSERT_TRUE(gc_arena_enter(&mrb, idx % 2 ? a : b, mrb_nil_value()));
+  ASSERT_FALSE(gc_arena_enter(&mrb, a, mrb_nil_value()));
+  for (int idx = GC_ARENA_MAX_ENTERED - 1; idx >= 0; idx--) ASSERT_TRUE(gc_arena_leave(&mrb, idx % 2 ? a : b));
+  ASSERT_EQ(7, mrb.gc.live);
+
+  gc_arena_free(&mrb, a);
+  gc_arena_free(&mrb, b);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+// Reproductions of the mruby functions `gc_arena_new_collection` relies on,
+// allocating objects and storage through the state as mruby does.
+static mrb_value test_ensure(mrb_state *mrb, mrb_func_t body, mrb_value b_data, mrb_func_t ensure, mrb_value e_data) {
+  mrb_value result = body(mrb, b_data);
+  ensure(mrb, e_data);
+  return result;
+}
+
+static void *test_new_object(mrb_state *mrb, enum mrb_vtype tt) {
+  ObjectSlot *slot = take_object(&mrb->gc);
+  memset(slot, 0, sizeof(ObjectSlot));
+  ((struct RBasic *)slot)->tt = tt;
+  return slot;
+}
+
+static mrb_value test_ary_new_capa(mrb_state *mrb, mrb_int capa) {
+  struct RArray *ary = test_new_object(mrb, MRB_TT_ARRAY);
+  ary->as.heap.aux.capa = capa;
+  ary->as.heap.ptr = mrb->allocf(mrb, NULL, sizeof(mrb_value) * capa, mrb->allocf_ud);
+  return mrb_obj_value(ary);
+}
+
+static void test_ary_push(mrb_state *mrb, mrb_value value, mrb_value item) {
+  struct RArray *ary = mrb_ary_ptr(value);
+  if (ary->as.heap.len == ary->as.heap.aux.capa) {
+    ary->as.heap.aux.capa = ary->as.heap.aux.capa ? ary->as.heap.aux.capa * 2 : 4;
+    ary->as.heap.ptr = mrb->allocf(mrb, ary->as.heap.ptr, sizeof(mrb_value) * ary->as.heap.aux.capa, mrb->allocf_ud);
+  }
+  ary->as.heap.ptr[ary->as.heap.len++] = item;
+}
+
+static mrb_value test_ary_entry(mrb_value ary, mrb_int idx) {
+  return RARRAY_PTR(ary)[idx];
+}
+
+static mrb_value test_str_new_capa(mrb_state *mrb, size_t capa) {
+  struct RString *str = test_new_object(mrb, MRB_TT_STRING);
+  str->as.heap.aux.capa = capa;
+  str->as.heap.ptr = mrb->allocf(mrb, NULL, capa + 1, mrb->allocf_ud);
+  return mrb_obj_value(str);
+}
+
+static mrb_value test_str_new(mrb_state *mrb, const char *ptr, size_t len) {
+  mrb_value str = test_str_new_capa(mrb, len);
+  memcpy(RSTRING_PTR(str), ptr, len);
+  mrb_str_ptr(str)->as.heap.len = len;
+  return str;
+}
+
+static struct RBasic *test_obj_alloc(mrb_state *mrb, enum mrb_vtype tt, struct RClass *cls) {
+  struct RBasic *obj = test_new_object(mrb, tt);
+  obj->c = cls;
+  return obj;
+}
+
+static void test_iv_foreach(mrb_state *mrb, mrb_value obj, int (*func)(mrb_state *, mrb_sym, mrb_value, void *), void *data) {
+}
+
+static mrb_value test_hash_new_capa(mrb_state *mrb, mrb_int capa) {
+  struct RHash *hash = test_new_object(mrb, MRB_TT_HASH);
+  hash->ht = mrb->allocf(mrb, NULL, sizeof(mrb_value) * 2 * capa, mrb->allocf_ud);
+  return mrb_obj_value(hash);
+}
+
+// Symbols are their name's length, and calls are recorded rather than made.
+static mrb_sym test_intern_static(mrb_state *mrb, const char *name, size_t len) {
+  return len;
+}
+
+static mrb_value test_calls[4][2];
+static size_t test_call_count;
+
+static mrb_value test_funcall_argv(mrb_state *mrb, mrb_value self, mrb_sym name, mrb_int argc, const mrb_value *argv) {
+  test_calls[test_call_count][0] = argv[0];
+  test_calls[test_call_count][1] = argv[1];
+  test_call_count++;
+  return mrb_nil_value();
+}
+
+static size_t test_roots;
+
+static void test_gc_register(mrb_state *mrb, mrb_value value) {
+  test_roots++;
+}
+
+static void test_gc_unregister(mrb_state *mrb, mrb_value value) {
+  test_roots--;
+}
+
+// Array stores are made from the GC heap (the registry), whose context is
+// recorded.
+static void *test_ary_set_ud;
+
+static void test_ary_set(mrb_state *mrb, mrb_value ary, mrb_int idx, mrb_value value) {
+  test_ary_set_ud = mrb->allocf_ud;
+  RARRAY_PTR(ary)[idx] = value;
+}
+
+static struct drb_api_t test_api = {
+  .mrb_ensure = test_ensure,
+  .mrb_gc_register = test_gc_register,
+  .mrb_gc_unregister = test_gc_unregister,
+  .mrb_intern_static = test_intern_static,
+  .mrb_funcall_argv = test_funcall_argv,
+  .mrb_ary_new_capa = test_ary_new_capa,
+  .mrb_ary_push = test_ary_push,
+  .mrb_ary_entry = test_ary_entry,
+  .mrb_ary_set = test_ary_set,
+  .mrb_str_new_capa = test_str_new_capa,
+  .mrb_str_new = test_str_new,
+  .mrb_iv_foreach = test_iv_foreach,
+  .mrb_obj_alloc = test_obj_alloc,
+  .mrb_hash_new_capa = test_hash_new_capa,
+};
+
+UTEST(gc_arena_collection, allocates_storage_once_at_the_requested_capacity) {
+  api = &test_api;
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *arena = gc_arena_allocate(&mrb, 8, 4096);
+
+  size_t used = arena->counters.used;
+  struct gc_arena_collection collection = {.type = GC_ARENA_COLLECTION_ARRAY, .capacity = 100, .items = mrb_nil_value()};
+  mrb_value ary = gc_arena_eval_func(&mrb, arena, gc_arena_new_collection, &collection);
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+  ASSERT_TRUE(is_in_arena(arena, mrb_ptr(ary)));
+  ASSERT_TRUE(is_in_arena(arena, RARRAY_PTR(ary)));
+  ASSERT_EQ(100, mrb_ary_ptr(ary)->as.heap.aux.capa);
+  ASSERT_EQ(used + sizeof(uint64_t) + sizeof(mrb_value) * 100, arena->counters.used);
+
+  // Appending up to the capacity neither moves nor grows the storage.
+  mrb_value *ptr = RARRAY_PTR(ary);
+  for (int idx = 0; idx < 100; idx++) test_ary_push(&mrb, ary, mrb_fixnum_value(idx));
+  ASSERT_EQ(ptr, RARRAY_PTR(ary));
+  ASSERT_EQ(used + sizeof(uint64_t) + sizeof(mrb_value) * 100, arena->counters.used);
+
+  collection = (struct gc_arena_collection){.type = GC_ARENA_COLLECTION_STRING, .capacity = 64, .items = mrb_nil_value()};
+  mrb_value str = gc_arena_eval_func(&mrb, arena, gc_arena_new_collection, &collection);
+  ASSERT_TRUE(is_in_arena(arena, mrb_ptr(str)));
+  ASSERT_TRUE(is_in_arena(arena, RSTRING_PTR(str)));
+  ASSERT_EQ(64, mrb_str_ptr(str)->as.heap.aux.capa);
+
+  collection = (struct gc_arena_collection){.type = GC_ARENA_COLLECTION_HASH, .capacity = 16, .items = mrb_nil_value()};
+  mrb_value hash = gc_arena_eval_func(&mrb, arena, gc_arena_new_collection, &collection);
+  ASSERT_TRUE(is_in_arena(arena, mrb_ptr(hash)));
+  ASSERT_TRUE(is_in_arena(arena, mrb_hash_ptr(hash)->ht));
+
+  gc_arena_free(&mrb, arena);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_collection, copies_items_into_an_array_of_their_size) {
+  api = &test_api;
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *arena = gc_arena_allocate(&mrb, 8, 4096);
+
+  mrb_value values[3] = {mrb_fixnum_value(1), mrb_fixnum_value(2), mrb_fixnum_value(3)};
+  struct RArray items = {.tt = MRB_TT_ARRAY, .as.heap = {.len = 3, .aux.capa = 3, .ptr = values}};
+  struct gc_arena_collection collection = {
+    .type = GC_ARENA_COLLECTION_ARRAY,
+    .capacity = 3,
+    .items = mrb_obj_value(&items),
+    .block = mrb_nil_value(),
+  };
+  size_t used = arena->counters.used;
+  mrb_value ary = gc_arena_eval_func(&mrb, arena, gc_arena_new_collection, &collection);
+  ASSERT_TRUE(is_in_arena(arena, RARRAY_PTR(ary)));
+  ASSERT_EQ(3, RARRAY_LEN(ary));
+  ASSERT_EQ(3, mrb_ary_ptr(ary)->as.heap.aux.capa);
+  ASSERT_EQ(3, mrb_fixnum(RARRAY_PTR(ary)[2]));
+  ASSERT_EQ(used + sizeof(uint64_t) + sizeof(mrb_value) * 3, arena->counters.used);
+
+  gc_arena_free(&mrb, arena);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_eval, entered_arenas_are_kept_alive_until_left) {
+  api = &test_api;
+  test_roots = 0;
+  mrb_value slots[GC_ARENA_MAX_ENTERED];
+  for (int idx = 0; idx < GC_ARENA_MAX_ENTERED; idx++) slots[idx] = mrb_nil_value();
+  struct RArray roots = {.tt = MRB_TT_ARRAY, .as.heap = {.len = GC_ARENA_MAX_ENTERED, .aux.capa = GC_ARENA_MAX_ENTERED, .ptr = slots}};
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf, .roots = mrb_obj_value(&roots)};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *a = gc_arena_allocate(&mrb, 8, 0);
+  struct RBasic owner = {.tt = MRB_TT_DATA};
+
+  // Owners fill the preallocated root slots, without registering GC roots.
+  ASSERT_TRUE(gc_arena_enter(&mrb, a, mrb_obj_value(&owner)));
+  ASSERT_EQ((void *)&owner, mrb_ptr(slots[0]));
+  ASSERT_TRUE(gc_arena_leave(&mrb, a));
+  ASSERT_TRUE(mrb_nil_p(slots[0]));
+  ASSERT_EQ(0, test_roots);
+
+  // Entered Arenas unwound by an eval are released too, with their slots
+  // written from the GC heap.
+  struct gc_arena_eval_cb_data eval = {.arena = a, .func = eval_nothing};
+  gc_arena_eval_body(&mrb, eval_cptr(&eval));
+  test_ary_set_ud = NULL;
+  ASSERT_TRUE(gc_arena_enter(&mrb, a, mrb_obj_value(&owner)));
+  ASSERT_EQ((void *)&registry, test_ary_set_ud);
+  ASSERT_EQ(a, mrb.allocf_ud);
+  ASSERT_TRUE(gc_arena_enter(&mrb, a, mrb_obj_value(&owner)));
+  ASSERT_EQ((void *)&owner, mrb_ptr(slots[1]));
+  gc_arena_eval_ensure(&mrb, eval_cptr(&eval));
+  ASSERT_TRUE(mrb_nil_p(slots[0]) && mrb_nil_p(slots[1]));
+  ASSERT_EQ(0, test_roots);
+  ASSERT_EQ(&registry, mrb.allocf_ud);
+
+  gc_arena_free(&mrb, a);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+// Builds `[str, [str, 42]]`, with both elements sharing the one String.
+static mrb_value build_graph(mrb_state *mrb, void *data) {
+  mrb_value str = test_str_new(mrb, data, strlen(data));
+  mrb_value inner = test_ary_new_capa(mrb, 2);
+  test_ary_push(mrb, inner, str);
+  test_ary_push(mrb, inner, mrb_fixnum_value(42));
+
+  mrb_value root = test_ary_new_capa(mrb, 2);
+  test_ary_push(mrb, root, str);
+  test_ary_push(mrb, root, inner);
+  return root;
+}
+
+UTEST(gc_arena_promote, copies_survive_resetting_the_original_arena) {
+  api = &test_api;
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *scratch = gc_arena_allocate(&mrb, 8, 1024);
+  struct gc_arena *level = gc_arena_allocate(&mrb, 8, 1024);
+
+  mrb_value original = gc_arena_eval_func(&mrb, scratch, build_graph, "hello");
+  struct gc_arena_promote promote = {.arena = level, .root = original};
+  mrb_value root = gc_arena_eval_func(&mrb, level, gc_arena_promote_objects, &promote);
+  gc_arena_promote_free(&promote);
+  ASSERT_FALSE(promote.error);
+
+  // Reuse the original's storage for a different graph.
+  gc_arena_reset(&mrb, scratch);
+  gc_arena_eval_func(&mrb, scratch, build_graph, "XXXXXXXX");
+
+  ASSERT_TRUE(is_in_arena(level, mrb_ptr(root)));
+  ASSERT_EQ(2, RARRAY_LEN(root));
+  mrb_value str = RARRAY_PTR(root)[0];
+  mrb_value inner = RARRAY_PTR(root)[1];
+  ASSERT_TRUE(is_in_arena(level, mrb_ptr(str)));
+  ASSERT_TRUE(is_in_arena(level, RSTRING_PTR(str)));
+  ASSERT_EQ(5, RSTRING_LEN(str));
+  ASSERT_EQ(0, memcmp("hello", RSTRING_PTR(str), 5));
+
+  ASSERT_TRUE(is_in_arena(level, mrb_ptr(inner)));
+  ASSERT_EQ(2, RARRAY_LEN(inner));
+  ASSERT_EQ(mrb_ptr(str), mrb_ptr(RARRAY_PTR(inner)[0]));
+  ASSERT_EQ(42, mrb_fixnum(RARRAY_PTR(inner)[1]));
+
+  gc_arena_free(&mrb, scratch);
+  gc_arena_free(&mrb, level);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+// Builds an instance of the given class, or of a new class of the given type
+// built within the active Arena.
+struct build_instance {
+  struct RClass *cls;
+  enum mrb_vtype class_tt;
+};
+
+static mrb_value build_instance(mrb_state *mrb, void *data) {
+  struct build_instance *build = data;
+  struct RClass *cls = build->cls ? build->cls : (struct RClass *)test_obj_alloc(mrb, build->class_tt, NULL);
+  return mrb_obj_value(test_obj_alloc(mrb, MRB_TT_OBJECT, cls));
+}
+
+static const char *promote_error(mrb_state *mrb, struct gc_arena *arena, mrb_value value, mrb_value *copy) {
+  struct gc_arena_promote promote = {.arena = arena, .root = value};
+  *copy = gc_arena_eval_func(mrb, arena, gc_arena_promote_objects, &promote);
+  gc_arena_promote_free(&promote);
+  return promote.error;
+}
+
+UTEST(gc_arena_promote, refuses_classes_that_would_be_reset) {
+  api = &test_api;
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *scratch = gc_arena_allocate(&mrb, 8, 1024);
+  struct gc_arena *level = gc_arena_allocate(&mrb, 8, 1024);
+  struct RClass heap_class = {.tt = MRB_TT_CLASS};
+  struct RClass singleton = {.tt = MRB_TT_SCLASS};
+  mrb_value copy;
+
+  // Instances of classes outside any Arena keep their class.
+  struct build_instance build = {.cls = &heap_class};
+  mrb_value obj = gc_arena_eval_func(&mrb, scratch, build_instance, &build);
+  mrb_value kept;
+  ASSERT_FALSE(promote_error(&mrb, level, obj, &kept));
+  ASSERT_TRUE(is_in_arena(level, mrb_ptr(kept)));
+  ASSERT_EQ(&heap_class, mrb_basic_ptr(kept)->c);
+
+  // Singleton classes aren't shared with copies.
+  build = (struct build_instance){.cls = &singleton};
+  obj = gc_arena_eval_func(&mrb, scratch, build_instance, &build);
+  ASSERT_TRUE(promote_error(&mrb, level, obj, &copy));
+
+  // Classes built within the source Arena are refused, as are their instances.
+  build = (struct build_instance){.class_tt = MRB_TT_CLASS};
+  obj = gc_arena_eval_func(&mrb, scratch, build_instance, &build);
+  ASSERT_TRUE(promote_error(&mrb, level, obj, &copy));
+  ASSERT_TRUE(promote_error(&mrb, level, mrb_obj_value(mrb_basic_ptr(obj)->c), &copy));
+
+  build = (struct build_instance){.class_tt = MRB_TT_SCLASS};
+  obj = gc_arena_eval_func(&mrb, scratch, build_instance, &build);
+  ASSERT_TRUE(promote_error(&mrb, level, obj, &copy));
+
+  // Classes within the target Arena are its own, and are kept as-is.
+  obj = gc_arena_eval_func(&mrb, level, build_instance, &build);
+  ASSERT_FALSE(promote_error(&mrb, level, mrb_obj_value(mrb_basic_ptr(obj)->c), &copy));
+
+  // Nothing accepted refers to the source once it's reset.
+  gc_arena_reset(&mrb, scratch);
+  ASSERT_TRUE(is_in_arena(level, mrb_ptr(kept)));
+  ASSERT_EQ(&heap_class, mrb_basic_ptr(kept)->c);
+
+  gc_arena_free(&mrb, scratch);
+  gc_arena_free(&mrb, level);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_limits, storage_beyond_the_limit_is_refused_or_falls_back) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 64);
+  arena->max_storage = 1024;
+  arena->growth.page_size = 256;
+  struct gc_arena_stats stats;
+
+  // The last page is trimmed to fit within the limit.
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, 512, arena));
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, 128, arena));
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, 160, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(1024, stats.total_storage);
+
+  ASSERT_FALSE(gc_arena_allocf(NULL, NULL, 64, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(1, stats.overflows);
+
+  arena->on_overflow = GC_ARENA_OVERFLOW_FALLBACK;
+  char *ptr = gc_arena_allocf(NULL, NULL, 64, arena);
+  strcpy(ptr, "Hello");
+  ASSERT_EQ(arena, gc_arena_index_find(arena->registry, ptr)->arena);
+
+  // Fallback blocks are moved on reallocation, rather than extended.
+  char *moved = gc_arena_allocf(NULL, ptr, 100, arena);
+  ASSERT_NE(ptr, moved);
+  ASSERT_STREQ("Hello", moved);
+
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(1024, stats.total_storage);
+  ASSERT_EQ(3, stats.overflows);
+  ASSERT_EQ(8 + 64 + 8 + 104, stats.fallback_storage);
+
+  gc_arena_reset(NULL, arena);
+  ASSERT_FALSE(arena->fallback);
+  ASSERT_FALSE(gc_arena_index_find(arena->registry, moved));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.fallback_storage);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_limits, fallback_blocks_share_indexed_pages) {
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *arena = gc_arena_allocate(&mrb, 0, 64);
+  arena->max_storage = 64;
+  arena->on_overflow = GC_ARENA_OVERFLOW_FALLBACK;
+  size_t ranges = registry.range_count;
+  void *ptrs[100];
+
+  // A burst of fallbacks fills a single page, indexed once.
+  for (int idx = 0; idx < 100; idx++) {
+    ptrs[idx] = gc_arena_allocf(&mrb, NULL, 64, arena);
+    ASSERT_EQ(arena->fallback, gc_arena_index_find(&registry, ptrs[idx])->page);
+  }
+  ASSERT_FALSE(arena->fallback->next);
+  ASSERT_EQ(ranges + 1, registry.range_count);
+
+  // Larger blocks get a page of their own, behind the page being filled.
+  void *large = gc_arena_allocf(&mrb, NULL, GC_ARENA_FALLBACK_PAGE_SIZE, arena);
+  ASSERT_EQ(arena->fallback->next, gc_arena_index_find(&registry, large)->page);
+  void *small = gc_arena_allocf(&mrb, NULL, 64, arena);
+  ASSERT_EQ(arena->fallback, gc_arena_index_find(&registry, small)->page);
+  ASSERT_EQ(ranges + 2, registry.range_count);
+
+  // Released pages leave empty ranges until half of the index is empty.
+  gc_arena_reset(&mrb, arena);
+  ASSERT_FALSE(gc_arena_index_find(&registry, ptrs[0]));
+  ASSERT_FALSE(gc_arena_index_find(&registry, large));
+  ASSERT_EQ(ranges, registry.range_count - registry.range_tombstones);
+
+  ASSERT_TRUE(gc_arena_allocf(&mrb, NULL, 64, arena));
+  ASSERT_EQ(0, registry.range_tombstones);
+  ASSERT_EQ(ranges + 1, registry.range_count);
+
+  gc_arena_free(&mrb, arena);
+  ASSERT_EQ(0, registry.range_count - registry.range_tombstones);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_limits, heap_pages_beyond_the_object_limit_fall_back) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+  arena->max_objects = 8 + GC_ARENA_HEAP_SLOTS;
+  struct gc_arena_stats stats;
+
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, GC_ARENA_HEAP_BYTES, arena));
+  ASSERT_FALSE(gc_arena_allocf(NULL, NULL, GC_ARENA_HEAP_BYTES, arena));
+
+  arena->on_overflow = GC_ARENA_OVERFLOW_FALLBACK;
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, GC_ARENA_HEAP_BYTES, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(8 + GC_ARENA_HEAP_SLOTS, stats.max_objects);
+  ASSERT_EQ(8 + 2 * GC_ARENA_HEAP_SLOTS, stats.total_objects);
+  ASSERT_EQ(GC_ARENA_HEAP_SLOTS, stats.fallback_objects);
+  ASSERT_EQ(2, stats.overflows);
+
+  // Reservations beyond the limits are refused outright.
+  ASSERT_FALSE(gc_arena_reserve(arena, 1, 0));
+  arena->max_objects = 0;
+  arena->max_storage = 4096;
+  ASSERT_FALSE(gc_arena_reserve(arena, 0, 65536));
+  ASSERT_EQ(8 + GC_ARENA_HEAP_SLOTS, arena->counters.objects);
+
+  gc_arena_reset(NULL, arena);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(8, stats.total_objects);
+  ASSERT_EQ(0, stats.fallback_objects);
+  gc_arena_free(NULL, arena);
+}
+
+// Overflows the Arena twice, returning the number of hook calls made meanwhile.
+static mrb_value overflow_storage(mrb_state *mrb, void *data) {
+  if (!mrb->allocf(mrb, NULL, 64, mrb->allocf_ud) || !mrb->allocf(mrb, NULL, 128, mrb->allocf_ud)) return mrb_nil_value();
+  return mrb_fixnum_value(test_call_count);
+}
+
+UTEST(gc_arena_limits, overflow_hooks_are_called_once_the_eval_returns) {
+  api = &test_api;
+  test_call_count = 0;
+  struct gc_arena_registry registry = {.registry = &registry, .allocf = test_allocf};
+  mrb_state mrb = {.allocf = gc_arena_allocf, .allocf_ud = &registry};
+  struct gc_arena *arena = gc_arena_allocate(&mrb, 0, 64);
+  arena->max_storage = 64;
+  arena->on_overflow = GC_ARENA_OVERFLOW_HOOK;
+
+  mrb_value calls = gc_arena_eval_func(&mrb, arena, overflow_storage, NULL);
+  ASSERT_EQ(0, mrb_fixnum(calls));
+  ASSERT_EQ(1, test_call_count);
+  ASSERT_EQ(7, mrb_symbol(test_calls[0][0]));
+  ASSERT_EQ(64 + 128, mrb_fixnum(test_calls[0][1]));
+  ASSERT_EQ(8 + 64 + 8 + 128, arena->fallback_storage);
+
+  // Reported overflows are not reported again, nor from within the Arena.
+  mrb.allocf_ud = arena;
+  ASSERT_TRUE(gc_arena_allocf(&mrb, NULL, 80, arena));
+  gc_arena_overflow_notify(&mrb, arena);
+  ASSERT_EQ(1, test_call_count);
+  mrb.allocf_ud = &registry;
+  gc_arena_overflow_notify(&mrb, arena);
+  ASSERT_EQ(2, test_call_count);
+  ASSERT_EQ(80, mrb_fixnum(test_calls[1][1]));
+  gc_arena_overflow_notify(&mrb, arena);
+  ASSERT_EQ(2, test_call_count);
+
+  gc_arena_free(&mrb, arena);
+  free(registry.blocks[0]);
+  free(registry.ranges);
+}
+
+UTEST(gc_arena_ring, generations_share_a_single_allocation) {
+  struct gc_arena_ring *ring = gc_arena_ring_allocate(NULL, 3, 16, 256);
+  ASSERT_EQ(3, ring->count);
+  ASSERT_EQ(0, ring->current);
+
+  for (size_t idx = 0; idx < ring->count; idx++) {
+    struct gc_arena *arena = ring->generations[idx];
+    ASSERT_TRUE(is_arena(arena->registry, arena));
+    ASSERT_TRUE(arena->page->shared);
+    ASSERT_TRUE((void *)arena->page >= ring->memory);
+    ASSERT_TRUE((void *)arena->page < ring->memory + 3 * (arena->page->end - (void *)arena->page));
+  }
+
+  gc_arena_ring_free(NULL, ring);
+}
+
+UTEST(gc_arena_ring, advance_resets_the_oldest_generation) {
+  struct gc_arena_ring *ring = gc_arena_ring_allocate(NULL, 2, 0, 256);
+  struct gc_arena *first = ring->generations[0];
+  struct gc_arena *second = ring->generations[1];
+
+  void *a = alloc_with_arena(first, 64);
+  gc_arena_ring_advance(NULL, ring);
+  ASSERT_EQ(1, ring->current);
+
+  // The previous generation is left untouched.
+  void *b = alloc_with_arena(second, 128);
+  ASSERT_EQ(a + 64, first->page->ptr);
+  gc_arena_ring_advance(NULL, ring);
+  ASSERT_EQ(0, ring->current);
+
+  // The oldest generation is reset for reuse.
+  ASSERT_EQ(a, alloc_with_arena(first, 32));
+  ASSERT_EQ(b + 128, second->page->ptr);
+
+  ASSERT_EQ(72, ring->generations[0]->peak_used_storage);
+  ASSERT_EQ(136, ring->generations[1]->peak_used_storage);
+
+  gc_arena_ring_free(NULL, ring);
+}
+
+UTEST(gc_arena_ring, overflow_pages_are_freed_with_the_ring) {
+  struct gc_arena_ring *ring = gc_arena_ring_allocate(NULL, 2, 0, 32);
+  struct gc_arena *first = ring->generations[0];
+  alloc_with_arena(first, 1024);
+  ASSERT_TRUE(first->page->next);
+  ASSERT_FALSE(first->page->shared);
+
+  gc_arena_ring_advance(NULL, ring);
+  gc_arena_ring_advance(NULL, ring);
+  ASSERT_FALSE(first->page->next);
+  ASSERT_TRUE(first->page->shared);
+
+  gc_arena_ring_free(NULL, ring);
+}
+
+UTEST(gc_arena_lazy_slots, only_the_first_heap_page_is_threaded) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 3000, 0);
+  mrb_heap_page *heap = arena->gc.heaps;
+  ASSERT_FALSE(heap->next);
+  ASSERT_EQ(2 * GC_ARENA_CHUNK_BYTES, arena->frontier_end - arena->frontier);
+
+  size_t threaded = 0;
+  for (struct RCptr *ptr = (void *)heap->freelist; ptr; ptr = ptr->p) threaded++;
+  ASSERT_EQ(3000 - 2 * GC_ARENA_HEAP_SLOTS, threaded);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(3000, stats.total_objects);
+  ASSERT_EQ(3000, stats.free_objects);
+  ASSERT_EQ(0, stats.total_storage);
+  ASSERT_EQ(0, stats.used_storage);
+}
+
+UTEST(gc_arena_lazy_slots, heap_pages_are_served_from_preallocated_slots) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 3000, 64);
+
+  for (size_t idx = 0; idx < 3000 - 2 * GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+  ASSERT_FALSE(arena->gc.free_heaps);
+
+  mrb_heap_page *second = add_heap(arena);
+  ASSERT_EQ(arena->frontier_end - 2 * GC_ARENA_CHUNK_BYTES + 8, (void *)second);
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+
+  mrb_heap_page *third = add_heap(arena);
+  ASSERT_EQ(arena->frontier_end, arena->frontier);
+  ASSERT_EQ((void *)second + GC_ARENA_CHUNK_BYTES, (void *)third);
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+
+  // Once exhausted, heap pages are carved from object pages, apart from storage.
+  mrb_heap_page *fourth = add_heap(arena);
+  ASSERT_FALSE(arena->page->next);
+  ASSERT_EQ(arena->object_page->start + 8, (void *)fourth);
+}
+
+UTEST(gc_arena_object_pages, keep_heap_pages_contiguous) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+  arena->object_growth.page_size = 2 * GC_ARENA_CHUNK_BYTES;
+  for (size_t idx = 0; idx < 8; idx++) take_object(&arena->gc);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+
+  // Storage allocated between heap pages lands elsewhere.
+  mrb_heap_page *first = add_heap(arena);
+  alloc_with_arena(arena, 4096);
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+  mrb_heap_page *second = add_heap(arena);
+  ASSERT_EQ((void *)first + GC_ARENA_CHUNK_BYTES, (void *)second);
+  ASSERT_EQ(3 * GC_ARENA_CHUNK_BYTES, page_capa(arena->object_page));
+
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+  add_heap(arena);
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+  add_heap(arena);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(2, stats.object_pages);
+  ASSERT_EQ(6 * GC_ARENA_CHUNK_BYTES, stats.object_storage);
+  ASSERT_EQ(8 + 4 * GC_ARENA_HEAP_SLOTS, stats.total_objects);
+  ASSERT_EQ(4096, stats.used_storage - stats.header_storage);
+
+  gc_arena_rewind(arena, &mark);
+  ASSERT_FALSE(arena->object_page);
+  ASSERT_EQ(arena->heap, arena->gc.heaps);
+
+  first = add_heap(arena);
+  gc_arena_reset(NULL, arena);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_FALSE(arena->object_page);
+  ASSERT_EQ(0, stats.object_pages + stats.object_storage);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_object_pages, are_sized_within_the_object_limit) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 0);
+  arena->max_objects = 8 + 3 * GC_ARENA_HEAP_SLOTS;
+
+  ASSERT_TRUE(gc_arena_allocf(NULL, NULL, GC_ARENA_HEAP_BYTES, arena));
+  ASSERT_EQ(3 * GC_ARENA_CHUNK_BYTES, page_capa(arena->object_page));
+
+  // Reserved heap pages share the object page.
+  ASSERT_TRUE(gc_arena_reserve(arena, 2 * GC_ARENA_HEAP_SLOTS, 0));
+  ASSERT_EQ(arena->object_page->end, arena->object_page->ptr);
+  ASSERT_EQ(1, arena->counters.object_pages);
+  ASSERT_FALSE(gc_arena_reserve(arena, 1, 0));
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_lazy_slots, reset_and_rewind_restore_the_frontier) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 2048, 0);
+  void *frontier = arena->frontier;
+  for (size_t idx = 0; idx < GC_ARENA_HEAP_SLOTS; idx++) take_object(&arena->gc);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  add_heap(arena);
+  take_object(&arena->gc);
+  ASSERT_EQ(arena->frontier_end, arena->frontier);
+
+  gc_arena_rewind(arena, &mark);
+  ASSERT_EQ(frontier, arena->frontier);
+  ASSERT_FALSE(arena->gc.free_heaps);
+  ASSERT_EQ(GC_ARENA_HEAP_SLOTS, arena->gc.live);
+
+  add_heap(arena);
+  gc_arena_reset(NULL, arena);
+  ASSERT_EQ(frontier, arena->frontier);
+  ASSERT_EQ(arena->heap, arena->gc.heaps);
+  ASSERT_FALSE(arena->gc.heaps->next);
+  ASSERT_EQ(0, arena->gc.live);
+}
+
 UTEST(gc_arena_stats, produces_basic_stats) {
   struct gc_arena *arena = gc_arena_allocate(NULL, 8, 32);
 
@@ -350,7 +1827,7 @@ UTEST(gc_arena_stats, produces_basic_stats) {
   ASSERT_EQ(0, stats.used_storage);
   ASSERT_EQ(32, stats.free_storage);
 
-  void *ptr1 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
 
   gc_arena_stats(NULL, arena, &stats);
   ASSERT_EQ(1, stats.pages);
@@ -361,7 +1838,7 @@ UTEST(gc_arena_stats, produces_basic_stats) {
   ASSERT_EQ(16, stats.used_storage);
   ASSERT_EQ(16, stats.free_storage);
 
-  void *ptr2 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
 
   gc_arena_stats(NULL, arena, &stats);
   ASSERT_EQ(1, stats.pages);
@@ -372,7 +1849,7 @@ UTEST(gc_arena_stats, produces_basic_stats) {
   ASSERT_EQ(32, stats.used_storage);
   ASSERT_EQ(0, stats.free_storage);
 
-  void *ptr3 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
 
   gc_arena_stats(NULL, arena, &stats);
   ASSERT_EQ(2, stats.pages);
@@ -382,6 +1859,517 @@ UTEST(gc_arena_stats, produces_basic_stats) {
   ASSERT_EQ(32 + 16 + (48 * 1024), stats.total_storage);
   ASSERT_EQ(48, stats.used_storage);
   ASSERT_EQ(48 * 1024, stats.free_storage);
+  ASSERT_EQ(16 + (48 * 1024), stats.average_page_size);
+}
+
+static struct gc_arena_page *linear_lookup(struct gc_arena **arenas, int count, void *ptr) {
+  for (int idx = 0; idx < count; idx++) {
+    for (struct gc_arena_page *page = arenas[idx]->page; page; page = page->next) {
+      if (ptr >= page->start && ptr < page->end) return page;
+    }
+  }
+  return NULL;
+}
+
+UTEST(gc_arena_stats, tracks_peaks_across_resets) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 32);
+  take_object(&arena->gc);
+  take_object(&arena->gc);
+  gc_arena_allocf(NULL, NULL, 24, arena);
+  gc_arena_allocf(NULL, NULL, 64, arena);
+  gc_arena_reset(NULL, arena);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(1, stats.pages);
+  ASSERT_EQ(0, stats.live_objects);
+  ASSERT_EQ(8, stats.free_objects);
+  ASSERT_EQ(0, stats.used_storage);
+  ASSERT_EQ(32, stats.total_storage);
+  ASSERT_EQ(2, stats.peak_live_objects);
+  ASSERT_EQ(32 + 72, stats.peak_used_storage);
+  ASSERT_EQ(2, stats.peak_pages);
+
+  take_object(&arena->gc);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(2, stats.peak_live_objects);
+}
+
+UTEST(gc_arena_stats, rewind_restores_counters) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 32);
+  gc_arena_allocf(NULL, NULL, 8, arena);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  take_object(&arena->gc);
+  gc_arena_allocf(NULL, NULL, 64, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(2, stats.pages);
+  ASSERT_EQ(16 + 72 + 16, stats.used_storage);
+
+  gc_arena_rewind(arena, &mark);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(1, stats.pages);
+  ASSERT_EQ(0, stats.live_objects);
+  ASSERT_EQ(32, stats.total_storage);
+  ASSERT_EQ(16, stats.used_storage);
+  ASSERT_EQ(16, stats.free_storage);
+  ASSERT_EQ(16 + 72 + 16, stats.peak_used_storage);
+}
+
+UTEST(gc_arena_stats, tracks_wasted_storage) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 64);
+  void *ptr1 = gc_arena_allocf(NULL, NULL, 8, arena);
+  void *ptr2 = gc_arena_allocf(NULL, NULL, 8, arena);
+
+  // Moving `ptr1` abandons its block; freeing `ptr2` wastes another.
+  void *ptr3 = gc_arena_allocf(NULL, ptr1, 16, arena);
+  gc_arena_allocf(NULL, ptr2, 0, arena);
+
+  // The last 8 bytes of the first page are skipped.
+  gc_arena_allocf(NULL, NULL, 32, arena);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(16 + 16 + 24 + 40, stats.used_storage);
+  ASSERT_EQ(16, stats.abandoned_storage);
+  ASSERT_EQ(16, stats.freed_storage);
+  ASSERT_EQ(8, stats.skipped_storage);
+  ASSERT_EQ((104 - 40) * 1000 / 104, stats.storage_efficiency);
+
+  // Growing into a skipped tail reclaims it.
+  ASSERT_EQ(ptr3, gc_arena_allocf(NULL, ptr3, 24, arena));
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.skipped_storage);
+
+  gc_arena_reset(NULL, arena);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.abandoned_storage + stats.freed_storage + stats.skipped_storage);
+  ASSERT_EQ(1000, stats.storage_efficiency);
+}
+
+UTEST(gc_arena_stats, recycled_blocks_are_not_wasted) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 8192);
+  gc_arena_set_recycle(arena, TRUE);
+
+  void *ptr1 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, ptr1, 64, arena);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  void *ptr2 = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, ptr2, 0, arena);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.abandoned_storage);
+  ASSERT_EQ(0, stats.freed_storage);
+
+  // Blocks too large for any size class can't be reused.
+  void *ptr3 = gc_arena_allocf(NULL, NULL, GC_ARENA_MAX_RECYCLED + 1, arena);
+  gc_arena_allocf(NULL, ptr3, 0, arena);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(8 + GC_ARENA_MAX_RECYCLED + 8, stats.freed_storage);
+
+  gc_arena_rewind(arena, &mark);
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.freed_storage);
+
+  gc_arena_set_recycle(arena, FALSE);
+}
+
+UTEST(gc_arena_intern, finds_strings_by_contents) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024);
+  static char names[100][8];
+  static struct RString strs[100];
+  for (int idx = 0; idx < 100; idx++) {
+    strs[idx] = (struct RString){.tt = MRB_TT_STRING, .as.heap = {.len = snprintf(names[idx], 8, "tile%d", idx), .ptr = names[idx]}};
+    ASSERT_FALSE(gc_arena_intern_find(arena, names[idx], strs[idx].as.heap.len, gc_arena_intern_hash(names[idx], strs[idx].as.heap.len)));
+    ASSERT_TRUE(gc_arena_intern_insert(arena, &strs[idx], gc_arena_intern_hash(names[idx], strs[idx].as.heap.len)));
+  }
+
+  // The table doubles as it fills, abandoning each outgrown copy.
+  ASSERT_EQ(100, arena->intern->count);
+  ASSERT_EQ(256, arena->intern->capa);
+  ASSERT_EQ(2 * (sizeof(uint64_t) + sizeof(struct gc_arena_intern)) + sizeof(struct gc_arena_intern_entry) * (64 + 128), arena->counters.abandoned);
+
+  for (int idx = 0; idx < 100; idx++) {
+    char copy[8];
+    memcpy(copy, names[idx], 8);
+    ASSERT_EQ(&strs[idx], gc_arena_intern_find(arena, copy, strs[idx].as.heap.len, gc_arena_intern_hash(copy, strs[idx].as.heap.len)));
+  }
+  ASSERT_FALSE(gc_arena_intern_find(arena, "tile", 4, gc_arena_intern_hash("tile", 4)));
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_intern, reset_and_rewind_discard_the_table) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024);
+  static struct RString str = {.tt = MRB_TT_STRING, .as.heap = {.len = 5, .ptr = "grass"}};
+  uint64_t hash = gc_arena_intern_hash("grass", 5);
+
+  struct gc_arena_mark mark;
+  gc_arena_mark(arena, &mark);
+  gc_arena_intern_insert(arena, &str, hash);
+  ASSERT_EQ(&str, gc_arena_intern_find(arena, "grass", 5, hash));
+  gc_arena_rewind(arena, &mark);
+  ASSERT_FALSE(gc_arena_intern_find(arena, "grass", 5, hash));
+
+  gc_arena_intern_insert(arena, &str, hash);
+  arena->counters.deduplicated += 5;
+  gc_arena_reset(NULL, arena);
+  ASSERT_FALSE(arena->intern);
+
+  struct gc_arena_stats stats;
+  gc_arena_stats(NULL, arena, &stats);
+  ASSERT_EQ(0, stats.deduplicated_storage);
+  gc_arena_free(NULL, arena);
+}
+
+UTEST(gc_arena_image, round_trips_pointers_between_slots_and_storage) {
+  char path[260];
+  temp_path(path);
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 256);
+  add_heap(arena);
+
+  // The objects live in an object page, which is stored with the others.
+  struct RArray *ary = take_object(&arena->gc);
+  struct RString *str = take_object(&arena->gc);
+  ASSERT_TRUE((void *)ary > arena->object_page->start && (void *)ary < arena->object_page->end);
+  char *bytes = gc_arena_allocf(NULL, NULL, 64, arena);
+  mrb_value *values = gc_arena_allocf(NULL, NULL, 4096, arena);
+  strcpy(bytes, "Hello");
+  *str = (struct RString){.tt = MRB_TT_STRING, .as.heap = {.len = 5, .ptr = bytes}};
+  values[0] = mrb_obj_value(str);
+  values[1] = mrb_obj_value(ary);
+  values[2] = mrb_fixnum_value(0x1234);
+  *ary = (struct RArray){.tt = MRB_TT_ARRAY, .as.heap = {.len = 3, .ptr = values}};
+  size_t live = arena->gc.live;
+
+  struct gc_arena_image_names classes = {0}, symbols = {0};
+  ASSERT_TRUE(gc_arena_image_dump(arena, path, ary, &classes, &symbols, 0));
+  gc_arena_free(NULL, arena);
+
+  struct gc_arena_image image;
+  void *root;
+  ASSERT_TRUE(gc_arena_image_open(path, &image));
+  struct gc_arena *loaded = gc_arena_image_restore(NULL, &image, NULL, &root);
+
+  struct RArray *loaded_ary = root;
+  mrb_value *loaded_values = loaded_ary->as.heap.ptr;
+  struct RString *loaded_str = mrb_ptr(loaded_values[0]);
+  ASSERT_TRUE(is_in_arena(loaded, loaded_ary));
+  ASSERT_TRUE(is_in_arena(loaded, loaded_values));
+  ASSERT_TRUE(is_in_arena(loaded, loaded_str));
+  ASSERT_TRUE(is_in_arena(loaded, loaded_str->as.heap.ptr));
+  ASSERT_EQ(0, strcmp(loaded_str->as.heap.ptr, "Hello"));
+  ASSERT_EQ(mrb_ptr(loaded_values[1]), (void *)loaded_ary);
+  ASSERT_EQ(mrb_fixnum(loaded_values[2]), 0x1234);
+  ASSERT_EQ(loaded->gc.live, live);
+  ASSERT_EQ(loaded->counters.pages, 2);
+  ASSERT_EQ(loaded->counters.object_pages, 1);
+  ASSERT_TRUE((void *)loaded_ary > loaded->object_page->start && (void *)loaded_ary < loaded->object_page->end);
+
+  // Loaded Arenas continue to allocate as usual.
+  ASSERT_TRUE(is_in_arena(loaded, take_object(&loaded->gc)));
+  ASSERT_TRUE(is_in_arena(loaded, gc_arena_allocf(NULL, NULL, 64, loaded)));
+  ASSERT_EQ(loaded->counters.pages, 3);
+
+  gc_arena_free(NULL, loaded);
+  gc_arena_image_names_free(&classes);
+  gc_arena_image_names_free(&symbols);
+  remove(path);
+}
+
+UTEST(gc_arena_image, leaves_data_resembling_pointers_alone) {
+  char path[260];
+  temp_path(path);
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 256);
+  struct RArray *ary = take_object(&arena->gc);
+  struct RString *str = take_object(&arena->gc);
+
+  // The string's contents and an integer both hold the array's address.
+  char *bytes = gc_arena_allocf(NULL, NULL, sizeof(void *), arena);
+  mrb_value *values = gc_arena_allocf(NULL, NULL, sizeof(mrb_value) * 2, arena);
+  memcpy(bytes, &ary, sizeof(void *));
+  *str = (struct RString){.tt = MRB_TT_STRING, .as.heap = {.len = sizeof(void *), .ptr = bytes}};
+  values[0] = mrb_obj_value(str);
+  values[1] = mrb_fixnum_value((intptr_t)ary);
+  *ary = (struct RArray){.tt = MRB_TT_ARRAY, .as.heap = {.len = 2, .ptr = values}};
+
+  struct gc_arena_image_names classes = {0}, symbols = {0};
+  ASSERT_TRUE(gc_arena_image_dump(arena, path, ary, &classes, &symbols, 0));
+
+  struct gc_arena_image image;
+  void *root;
+  ASSERT_TRUE(gc_arena_image_open(path, &image));
+  struct gc_arena *loaded = gc_arena_image_restore(NULL, &image, NULL, &root);
+  ASSERT_NE(root, (void *)ary);
+
+  mrb_value *loaded_values = ((struct RArray *)root)->as.heap.ptr;
+  struct RString *loaded_str = mrb_ptr(loaded_values[0]);
+  ASSERT_EQ(0, memcmp(loaded_str->as.heap.ptr, &ary, sizeof(void *)));
+  ASSERT_EQ(mrb_fixnum(loaded_values[1]), (intptr_t)ary);
+
+  gc_arena_free(NULL, loaded);
+  gc_arena_free(NULL, arena);
+  gc_arena_image_names_free(&classes);
+  gc_arena_image_names_free(&symbols);
+  remove(path);
+}
+
+UTEST(gc_arena_image, keeps_run_pages_sized) {
+  char path[260];
+  temp_path(path);
+  struct gc_arena *arena = gc_arena_allocate(NULL, 8, 256);
+  gc_arena_set_recycle(arena, TRUE);
+  struct RArray *ary = take_object(&arena->gc);
+  struct RString *str = take_object(&arena->gc);
+
+  // Both blocks are small enough to be carved from runs.
+  char *bytes = gc_arena_allocf(NULL, NULL, 6, arena);
+  mrb_value *values = gc_arena_allocf(NULL, NULL, sizeof(mrb_value) * 2, arena);
+  ASSERT_TRUE(arena->run_page);
+  strcpy(bytes, "Hello");
+  *str = (struct RString){.tt = MRB_TT_STRING, .as.heap = {.len = 5, .ptr = bytes}};
+  values[0] = mrb_obj_value(str);
+  values[1] = mrb_obj_value(ary);
+  *ary = (struct RArray){.tt = MRB_TT_ARRAY, .as.heap = {.len = 2, .ptr = values}};
+
+  struct gc_arena_image_names classes = {0}, symbols = {0};
+  ASSERT_TRUE(gc_arena_image_dump(arena, path, ary, &classes, &symbols, 0));
+  gc_arena_set_recycle(arena, FALSE);
+  gc_arena_free(NULL, arena);
+
+  struct gc_arena_image image;
+  void *root;
+  ASSERT_TRUE(gc_arena_image_open(path, &image));
+  struct gc_arena *loaded = gc_arena_image_restore(NULL, &image, NULL, &root);
+
+  mrb_value *loaded_values = ((struct RArray *)root)->as.heap.ptr;
+  struct RString *loaded_str = mrb_ptr(loaded_values[0]);
+  ASSERT_EQ(mrb_ptr(loaded_values[1]), root);
+  ASSERT_EQ(0, strcmp(loaded_str->as.heap.ptr, "Hello"));
+  ASSERT_EQ(8, is_in_arena(loaded, loaded_str->as.heap.ptr)->run_size);
+
+  // Blocks in loaded runs are still sized by their run when reallocated.
+  char *grown = gc_arena_allocf(NULL, loaded_str->as.heap.ptr, 64, loaded);
+  ASSERT_EQ(0, strcmp(grown, "Hello"));
+  ASSERT_EQ(64, ((uint64_t *)grown)[-1]);
+
+  gc_arena_free(NULL, loaded);
+  gc_arena_image_names_free(&classes);
+  gc_arena_image_names_free(&symbols);
+  remove(path);
+}
+
+UTEST(gc_arena_image, resolves_classes_through_the_class_table) {
+  char path[260];
+  temp_path(path);
+  static struct RCptr old_class, new_class;
+  struct gc_arena *arena = gc_arena_allocate(NULL, 16, 0);
+  struct RCptr *obj = take_object(&arena->gc);
+  obj->c = (struct RClass *)&old_class;
+
+  struct gc_arena_image_names classes = {0}, symbols = {0};
+  gc_arena_image_names_set(&classes, gc_arena_image_names_add(&classes, (uintptr_t)&old_class), "Point", 5);
+  ASSERT_EQ(gc_arena_image_names_add(&classes, (uintptr_t)&old_class), SIZE_MAX);
+  ASSERT_TRUE(gc_arena_image_dump(arena, path, obj, &classes, &symbols, 0));
+  gc_arena_free(NULL, arena);
+
+  struct gc_arena_image image;
+  void *root;
+  ASSERT_TRUE(gc_arena_image_open(path, &image));
+  ASSERT_EQ(image.header->class_count, 1);
+  ASSERT_EQ(0, memcmp(image.names + image.classes[0].offset, "Point", 5));
+
+  struct RClass *resolved[] = {(struct RClass *)&new_class};
+  struct gc_arena *loaded = gc_arena_image_restore(NULL, &image, resolved, &root);
+  ASSERT_EQ((void *)((struct RCptr *)root)->c, (void *)&new_class);
+
+  gc_arena_free(NULL, loaded);
+  gc_arena_image_names_free(&classes);
+  gc_arena_image_names_free(&symbols);
+  remove(path);
+}
+
+UTEST(gc_arena_image, rejects_other_files) {
+  char path[260];
+  temp_path(path);
+  remove(path);
+  struct gc_arena_image image;
+  ASSERT_FALSE(gc_arena_image_open(path, &image));
+
+  FILE *file = fopen(path, "wb");
+  char contents[4096] = GC_ARENA_TRACE_MAGIC;
+  fwrite(contents, 1, sizeof(contents), file);
+  fclose(file);
+  ASSERT_FALSE(gc_arena_image_open(path, &image));
+  remove(path);
+}
+
+UTEST(gc_arena_promote, maps_originals_to_copies_across_growth) {
+  static ObjectSlot from[1000], to[1000];
+  struct gc_arena_promote promote = {0};
+  ASSERT_EQ(NULL, gc_arena_promote_lookup(&promote, (struct RBasic *)&from[0]));
+
+  for (int idx = 0; idx < 1000; idx++) gc_arena_promote_insert(&promote, (struct RBasic *)&from[idx], (struct RBasic *)&to[idx]);
+
+  ASSERT_EQ(1000, promote.count);
+  ASSERT_GE(promote.capa, 2000);
+  for (int idx = 0; idx < 1000; idx++) {
+    ASSERT_EQ((struct RBasic *)&to[idx], gc_arena_promote_lookup(&promote, (struct RBasic *)&from[idx]));
+  }
+  ASSERT_EQ(NULL, gc_arena_promote_lookup(&promote, (struct RBasic *)&to[0]));
+
+  gc_arena_promote_free(&promote);
+}
+
+#ifdef GC_ARENA_PROFILE
+UTEST(gc_arena_profile, buckets_allocations_by_size) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024);
+  gc_arena_allocf(NULL, NULL, 1, arena);
+  gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, NULL, 9, arena);
+  gc_arena_allocf(NULL, NULL, 16, arena);
+  gc_arena_allocf(NULL, NULL, 600, arena);
+
+  ASSERT_EQ(1, arena->profile.sizes[0]);
+  ASSERT_EQ(1, arena->profile.sizes[3]);
+  ASSERT_EQ(2, arena->profile.sizes[4]);
+  ASSERT_EQ(1, arena->profile.sizes[10]);
+}
+
+UTEST(gc_arena_profile, counts_realloc_outcomes) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 0, 1024);
+  void *a = gc_arena_allocf(NULL, NULL, 8, arena);
+  void *b = gc_arena_allocf(NULL, NULL, 8, arena);
+  gc_arena_allocf(NULL, b, 32, arena);
+  gc_arena_allocf(NULL, a, 32, arena);
+
+  ASSERT_EQ(1, arena->profile.realloc_in_place);
+  ASSERT_EQ(1, arena->profile.realloc_copied);
+}
+
+UTEST(gc_arena_profile, census_counts_live_objects_by_type) {
+  struct gc_arena *arena = gc_arena_allocate(NULL, 1100, 0);
+  for (int idx = 0; idx < 76; idx++) ((struct RBasic *)take_object(&arena->gc))->tt = MRB_TT_STRING;
+  add_heap(arena);
+  for (int idx = 0; idx < 3; idx++) ((struct RBasic *)take_object(&arena->gc))->tt = MRB_TT_HASH;
+  take_object(&arena->gc);
+
+  size_t census[MRB_TT_MAXDEFINE];
+  gc_arena_census(arena, census);
+  ASSERT_EQ(76, census[MRB_TT_STRING]);
+  ASSERT_EQ(3, census[MRB_TT_HASH]);
+  ASSERT_EQ(1, census[MRB_TT_OBJECT]);
+  ASSERT_EQ(0, census[MRB_TT_FREE]);
+}
+#endif
+
+#ifdef GC_ARENA_TRACE
+UTEST(gc_arena_trace, records_arena_allocations) {
+  char path[260];
+  temp_path(path);
+
+  struct gc_arena *existing = gc_arena_allocate(NULL, 16, 128);
+  uint32_t trace_id = existing->trace_id;
+  ASSERT_TRUE(gc_arena_trace_start(&gc_arena_default_registry, path));
+  ASSERT_FALSE(gc_arena_trace_start(&gc_arena_default_registry, path));
+
+  void *ptr = gc_arena_allocf(NULL, NULL, 24, existing);
+  ptr = gc_arena_allocf(NULL, ptr, 200, existing);
+  gc_arena_allocf(NULL, ptr, 0, existing);
+  free(gc_arena_allocf(NULL, NULL, 24, NULL));
+  gc_arena_reset(NULL, existing);
+  gc_arena_free(NULL, existing);
+  gc_arena_trace_stop();
+
+  // Other Arenas which are still live are also introduced; we only care about
+  // the records for this one.
+  FILE *file = fopen(path, "rb");
+  uint8_t header[8], records[6][GC_ARENA_TRACE_RECORD_SIZE], record[GC_ARENA_TRACE_RECORD_SIZE];
+  ASSERT_EQ(8, fread(header, 1, 8, file));
+  ASSERT_EQ(0, memcmp(header, GC_ARENA_TRACE_MAGIC, 4));
+
+  int count = 0;
+  while (fread(record, 1, GC_ARENA_TRACE_RECORD_SIZE, file) == GC_ARENA_TRACE_RECORD_SIZE) {
+    uint32_t id = record[1] | record[2] << 8 | record[3] << 16 | (uint32_t)record[4] << 24;
+    if (id != trace_id) continue;
+    ASSERT_LT(count, 6);
+    memcpy(records[count++], record, GC_ARENA_TRACE_RECORD_SIZE);
+  }
+  fclose(file);
+  remove(path);
+
+  uint8_t expected_ops[] = {
+    GC_ARENA_TRACE_NEW,
+    GC_ARENA_TRACE_MALLOC,
+    GC_ARENA_TRACE_REALLOC,
+    GC_ARENA_TRACE_FREE,
+    GC_ARENA_TRACE_RESET,
+    GC_ARENA_TRACE_DESTROY,
+  };
+  ASSERT_EQ(6, count);
+  for (int idx = 0; idx < 6; idx++) ASSERT_EQ(expected_ops[idx], records[idx][0]);
+
+  // Arena creation carries the object count and storage; blocks keep their
+  // id across reallocation.
+  ASSERT_EQ(16, records[0][5]);
+  ASSERT_EQ(128, records[0][9]);
+  ASSERT_EQ(0, memcmp(records[1] + 5, records[2] + 5, 4));
+  ASSERT_EQ(0, memcmp(records[1] + 5, records[3] + 5, 4));
+  ASSERT_EQ(200, records[2][9]);
+}
+
+UTEST(gc_arena_trace, pointer_ids_survive_removal_of_colliding_entries) {
+  gc_arena_trace_map_capa = 0;
+  void *ptrs[3000];
+  for (int idx = 0; idx < 3000; idx++) {
+    ptrs[idx] = (void *)(uintptr_t)((idx + 1) * 8);
+    ASSERT_EQ(idx + 100, gc_arena_trace_insert(ptrs[idx], idx + 100));
+  }
+
+  for (int idx = 0; idx < 3000; idx += 2) {
+    ASSERT_EQ(idx + 100, gc_arena_trace_lookup(ptrs[idx], TRUE));
+  }
+
+  for (int idx = 0; idx < 3000; idx++) {
+    ASSERT_EQ(idx % 2 ? idx + 100 : UINT32_MAX, gc_arena_trace_lookup(ptrs[idx], FALSE));
+  }
+
+  ASSERT_EQ(1500, gc_arena_trace_map_count);
+  free(gc_arena_trace_map);
+  gc_arena_trace_map = NULL;
+  gc_arena_trace_map_count = 0;
+  gc_arena_trace_map_capa = 0;
+}
+#endif
+
+UTEST(gc_arena_index, realloc_finds_blocks_across_many_arenas_and_pages) {
+  enum { ARENAS = 4, PAGES = 16 };
+  struct gc_arena *arenas[ARENAS];
+  void *ptrs[ARENAS * PAGES];
+
+  for (int idx = 0; idx < ARENAS; idx++) {
+    arenas[idx] = gc_arena_allocate(NULL, 0, 0);
+    for (int page = 0; page < PAGES; page++) {
+      add_page(arenas[idx], 0);
+      ptrs[idx * PAGES + page] = alloc_with_arena(arenas[idx], 8);
+    }
+  }
+
+  // The index agrees with a walk of every page, and resizes in place.
+  for (int idx = 0; idx < ARENAS * PAGES; idx++) {
+    void *ptr = ptrs[idx];
+    ASSERT_EQ(linear_lookup(arenas, ARENAS, ptr), gc_arena_index_find(arenas[0]->registry, ptr)->page);
+    ASSERT_EQ(ptr, gc_arena_allocf(NULL, ptr, 8, NULL));
+  }
+
+  for (int idx = 0; idx < ARENAS; idx++) gc_arena_free(NULL, arenas[idx]);
 }
 
 UTEST_MAIN()